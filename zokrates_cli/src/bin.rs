@@ -5,19 +5,28 @@
 // @date 2017
 
 use bincode::{deserialize_from, serialize_into, Infinite};
-use clap::{App, AppSettings, Arg, SubCommand};
-use serde_json::Value;
+use clap::{App, AppSettings, Arg, ArgMatches, SubCommand};
+use serde_json::{json, Value};
+use std::collections::HashMap;
 use std::env;
-use std::fs::File;
-use std::io::{stdin, BufReader, BufWriter, Read, Write};
+use std::fs::{self, File};
+use std::io::{self, stdin, BufRead, BufReader, BufWriter, Read, Write};
 use std::path::{Path, PathBuf};
 use std::string::String;
+use std::time::SystemTime;
 use zokrates_core::compile::compile;
 use zokrates_core::ir;
 use zokrates_core::proof_system::*;
 use zokrates_field::field::{Field, FieldPrime};
 use zokrates_fs_resolver::resolve as fs_resolve;
 
+const FLATTENED_CODE_DEFAULT_PATH: &str = "out";
+const VERIFICATION_KEY_DEFAULT_PATH: &str = "verification.key";
+const PROVING_KEY_DEFAULT_PATH: &str = "proving.key";
+const VERIFICATION_CONTRACT_DEFAULT_PATH: &str = "verifier.sol";
+const WITNESS_DEFAULT_PATH: &str = "witness";
+const JSON_PROOF_PATH: &str = "proof.json";
+
 fn main() {
     cli().unwrap_or_else(|e| {
         println!("{}", e);
@@ -26,12 +35,6 @@ fn main() {
 }
 
 fn cli() -> Result<(), String> {
-    const FLATTENED_CODE_DEFAULT_PATH: &str = "out";
-    const VERIFICATION_KEY_DEFAULT_PATH: &str = "verification.key";
-    const PROVING_KEY_DEFAULT_PATH: &str = "proving.key";
-    const VERIFICATION_CONTRACT_DEFAULT_PATH: &str = "verifier.sol";
-    const WITNESS_DEFAULT_PATH: &str = "witness";
-    const JSON_PROOF_PATH: &str = "proof.json";
     let default_scheme = env::var("ZOKRATES_PROVING_SCHEME").unwrap_or(String::from("g16"));
 
     // cli specification using clap library
@@ -104,6 +107,63 @@ fn cli() -> Result<(), String> {
             .long("light")
             .help("Skip logs and human readable output")
             .required(false)
+        ).arg(Arg::with_name("compress-keys")
+            .long("compress-keys")
+            .help("Store the points of the proving key compressed, about half the size, at the cost of a square root per point when loading it (same as ZOKRATES_COMPRESS_KEYS=1)")
+            .required(false)
+        ).arg(Arg::with_name("dense-keys")
+            .long("dense-keys")
+            .help("Store every point of the proving key's queries, points at infinity included, instead of only the others with their indices (same as ZOKRATES_DENSE_KEYS=1)")
+            .required(false)
+        ).arg(Arg::with_name("fresh-keys")
+            .long("fresh-keys")
+            .help("Generate new keys even if an identical constraint system was set up before, instead of reusing its stored keys (same as ZOKRATES_FRESH_KEYS=1)")
+            .required(false)
+        ).arg(Arg::with_name("keys-store")
+            .long("keys-store")
+            .help("Directory storing the keys of the constraint systems set up so far, to reuse them for identical ones (same as ZOKRATES_SETUP_KEYS). Keys are not stored without it")
+            .value_name("DIR")
+            .takes_value(true)
+            .required(false)
+        ).arg(Arg::with_name("threads")
+            .long("threads")
+            .help("Number of threads the libsnark backends may use. Defaults to OMP_NUM_THREADS or one per core, requires the `multicore` feature")
+            .value_name("N")
+            .takes_value(true)
+            .required(false)
+        )
+    )
+    .subcommand(SubCommand::with_name("prepare-key")
+        .about("Precomputes the prover's multi-exponentiation tables for a proving key, written to <proving key>.prepared and used by generate-proof from then on. Trades disk space, several times the key's size, for faster proofs")
+        .arg(Arg::with_name("proving-key-path")
+            .short("p")
+            .long("proving-key-path")
+            .help("Path of the proving key file")
+            .value_name("FILE")
+            .takes_value(true)
+            .required(false)
+            .default_value(PROVING_KEY_DEFAULT_PATH)
+        )
+        .arg(Arg::with_name("proving-scheme")
+            .short("s")
+            .long("proving-scheme")
+            .help("Proving scheme of the keys. Available options are PGHR13 and GM17")
+            .value_name("FILE")
+            .takes_value(true)
+            .required(false)
+            .default_value(&default_scheme)
+        ).arg(Arg::with_name("window")
+            .long("window")
+            .help("Width in bits of the scalar digits: larger windows make smaller tables but more buckets to sum, and are narrowed where the buckets would take over 1 GiB. Picked per table by default")
+            .value_name("BITS")
+            .takes_value(true)
+            .required(false)
+        ).arg(Arg::with_name("threads")
+            .long("threads")
+            .help("Number of threads the libsnark backends may use. Defaults to OMP_NUM_THREADS or one per core, requires the `multicore` feature")
+            .value_name("N")
+            .takes_value(true)
+            .required(false)
         )
     )
     .subcommand(SubCommand::with_name("compute-witness")
@@ -142,9 +202,10 @@ fn cli() -> Result<(), String> {
         .arg(Arg::with_name("witness")
             .short("w")
             .long("witness")
-            .help("Path of the witness file")
+            .help("Path of the witness file, several witnesses are proven against the same key in one call")
             .value_name("FILE")
             .takes_value(true)
+            .multiple(true)
             .required(false)
             .default_value(WITNESS_DEFAULT_PATH)
         ).arg(Arg::with_name("provingkey")
@@ -158,9 +219,10 @@ fn cli() -> Result<(), String> {
         ).arg(Arg::with_name("proofpath")
             .short("j")
             .long("proofpath")
-            .help("Path of the JSON proof file")
+            .help("Path of the JSON proof file, one per witness")
             .value_name("FILE")
             .takes_value(true)
+            .multiple(true)
             .required(false)
             .default_value(JSON_PROOF_PATH)
         ).arg(Arg::with_name("input")
@@ -179,6 +241,12 @@ fn cli() -> Result<(), String> {
             .takes_value(true)
             .required(false)
             .default_value(&default_scheme)
+        ).arg(Arg::with_name("threads")
+            .long("threads")
+            .help("Number of threads the libsnark backends may use. Defaults to OMP_NUM_THREADS or one per core, requires the `multicore` feature")
+            .value_name("N")
+            .takes_value(true)
+            .required(false)
         )
     )
     .subcommand(SubCommand::with_name("print-proof")
@@ -222,9 +290,10 @@ fn cli() -> Result<(), String> {
         ).arg(Arg::with_name("proofpath")
             .short("j")
             .long("proofpath")
-            .help("Path of the JSON proof file")
+            .help("Path of the JSON proof file, several proofs are verified against the same key in one call")
             .value_name("FILE")
             .takes_value(true)
+            .multiple(true)
             .required(false)
             .default_value(JSON_PROOF_PATH)
         ).arg(Arg::with_name("input")
@@ -274,8 +343,26 @@ fn cli() -> Result<(), String> {
             .default_value(&default_scheme)
         )
     )
+    .subcommand(SubCommand::with_name("serve")
+        .about("Keeps curve parameters and proving keys loaded and generates a proof for each request read from stdin.\nRequests and responses are JSON objects, one per line: {\"input\": .., \"witness\": .., \"provingkey\": .., \"proofpath\": ..} -> {\"ok\": true}")
+        .arg(Arg::with_name("proving-scheme")
+            .short("s")
+            .long("proving-scheme")
+            .help("Proving scheme to use to generate the proofs. Available options are G16, PGHR13 and GM17")
+            .value_name("FILE")
+            .takes_value(true)
+            .required(false)
+            .default_value(&default_scheme)
+        ).arg(Arg::with_name("threads")
+            .long("threads")
+            .help("Number of threads the libsnark backends may use. Defaults to OMP_NUM_THREADS or one per core, requires the `multicore` feature")
+            .value_name("N")
+            .takes_value(true)
+            .required(false)
+        )
+    )
     .subcommand(SubCommand::with_name("batch")
-        .about("Aggregate 2 PGHR13 proofs into a single proof on a pairing curve")
+        .about("Aggregate PGHR13 proofs into a single proof on a pairing curve")
         .arg(Arg::with_name("from_curve")
              .long("from_curve")
              .help("Simple proofs curve")
@@ -286,13 +373,39 @@ fn cli() -> Result<(), String> {
              .long("from_1")
              .help("First simple proof folder")
              .takes_value(true)
-             .required(true)
+             .required_unless("from")
          )
         .arg(Arg::with_name("from_2")
              .long("from_2")
              .help("Second simple proof folder")
              .takes_value(true)
-             .required(true)
+             .required_unless("from")
+         )
+        .arg(Arg::with_name("from")
+             .long("from")
+             .help("Simple proof folders, aggregated after --from_1 and --from_2")
+             .takes_value(true)
+             .multiple(true)
+             .required(false)
+         )
+        .arg(Arg::with_name("tree")
+             .long("tree")
+             .help("Aggregate --arity proofs at a time, alternating curves layer after layer until a single proof is left")
+             .required(false)
+         )
+        .arg(Arg::with_name("arity")
+             .long("arity")
+             .help("Number of proofs aggregated by each proof of the tree, used with --tree")
+             .takes_value(true)
+             .required(false)
+             .default_value("2")
+         )
+        .arg(Arg::with_name("keys-dir")
+             .long("keys-dir")
+             .help("Directory caching the aggregator proving and verification keys, an empty value disables the cache. Defaults to ~/.zokrates/aggregator_keys")
+             .value_name("DIR")
+             .takes_value(true)
+             .required(false)
          )
         .arg(Arg::with_name("to_curve")
              .long("to_curve")
@@ -300,6 +413,13 @@ fn cli() -> Result<(), String> {
              .takes_value(true)
              .required(true)
          )
+        .arg(Arg::with_name("threads")
+            .long("threads")
+            .help("Number of threads the libsnark backends may use. Defaults to OMP_NUM_THREADS or one per core, requires the `multicore` feature")
+            .value_name("N")
+            .takes_value(true)
+            .required(false)
+        )
     )
     .get_matches();
 
@@ -372,6 +492,19 @@ fn cli() -> Result<(), String> {
         }
         ("setup", Some(sub_matches)) => {
             let scheme = get_scheme(sub_matches.value_of("proving-scheme").unwrap())?;
+            set_threads_from(sub_matches)?;
+            if sub_matches.is_present("compress-keys") {
+                env::set_var("ZOKRATES_COMPRESS_KEYS", "1");
+            }
+            if sub_matches.is_present("dense-keys") {
+                env::set_var("ZOKRATES_DENSE_KEYS", "1");
+            }
+            if sub_matches.is_present("fresh-keys") {
+                env::set_var("ZOKRATES_FRESH_KEYS", "1");
+            }
+            if let Some(dir) = sub_matches.value_of("keys-store") {
+                env::set_var("ZOKRATES_SETUP_KEYS", dir);
+            }
 
             println!("Performing setup...");
 
@@ -396,6 +529,25 @@ fn cli() -> Result<(), String> {
             // run setup phase
             scheme.setup(program, pk_path, vk_path);
         }
+        ("prepare-key", Some(sub_matches)) => {
+            let scheme = get_scheme(sub_matches.value_of("proving-scheme").unwrap())?;
+            set_threads_from(sub_matches)?;
+            let window = match sub_matches.value_of("window") {
+                Some(window) => match window.parse() {
+                    Ok(w) if w >= 1 && w <= 24 => w,
+                    _ => return Err(format!("Invalid window: {}, expected 1 to 24 bits", window)),
+                },
+                None => 0,
+            };
+
+            println!("Preparing proving key...");
+
+            let pk_path = sub_matches.value_of("proving-key-path").unwrap();
+            if !scheme.prepare_proving_key(pk_path, window) {
+                return Err(format!("could not prepare {}", pk_path));
+            }
+            println!("Prepared proving key written to {}.prepared", pk_path);
+        }
         ("compute-witness", Some(sub_matches)) => {
             println!("Computing witness...");
 
@@ -476,19 +628,38 @@ fn cli() -> Result<(), String> {
             println!("Generating proof...");
 
             let scheme = get_scheme(sub_matches.value_of("proving-scheme").unwrap())?;
+            set_threads_from(sub_matches)?;
 
-            // deserialize witness
-            let witness_path = Path::new(sub_matches.value_of("witness").unwrap());
-            let witness_file = match File::open(&witness_path) {
-                Ok(file) => file,
-                Err(why) => panic!("couldn't open {}: {}", witness_path.display(), why),
-            };
+            let witness_paths: Vec<&str> = sub_matches.values_of("witness").unwrap().collect();
+            let proof_paths: Vec<String> = sub_matches
+                .values_of("proofpath")
+                .unwrap()
+                .map(String::from)
+                .collect();
+            if witness_paths.len() != proof_paths.len() {
+                return Err(format!(
+                    "{} witnesses but {} proof paths, expected one proof path per witness",
+                    witness_paths.len(),
+                    proof_paths.len()
+                ));
+            }
 
-            let witness = ir::Witness::read(witness_file)
-                .map_err(|why| format!("could not load witness: {:?}", why))?;
+            // deserialize witnesses
+            let mut witnesses = vec![];
+            for witness_path in &witness_paths {
+                let witness_path = Path::new(witness_path);
+                let witness_file = match File::open(&witness_path) {
+                    Ok(file) => file,
+                    Err(why) => panic!("couldn't open {}: {}", witness_path.display(), why),
+                };
+
+                witnesses.push(
+                    ir::Witness::read(witness_file)
+                        .map_err(|why| format!("could not load witness: {:?}", why))?,
+                );
+            }
 
             let pk_path = sub_matches.value_of("provingkey").unwrap();
-            let proof_path = sub_matches.value_of("proofpath").unwrap();
 
             let program_path = Path::new(sub_matches.value_of("input").unwrap());
             let program_file = File::open(&program_path)
@@ -499,10 +670,21 @@ fn cli() -> Result<(), String> {
             let program: ir::Prog<FieldPrime> =
                 deserialize_from(&mut reader, Infinite).map_err(|why| format!("{:?}", why))?;
 
-            println!(
-                "generate-proof successful: {:?}",
-                scheme.generate_proof(program, witness, pk_path, proof_path)
-            );
+            if witnesses.len() == 1 {
+                println!(
+                    "generate-proof successful: {:?}",
+                    scheme.generate_proof(program, witnesses.remove(0), pk_path, &proof_paths[0])
+                );
+            } else {
+                let results = scheme.generate_proofs(program, witnesses, pk_path, &proof_paths);
+                for (proof_path, ok) in proof_paths.iter().zip(&results) {
+                    println!("{}: {:?}", proof_path, ok);
+                }
+                println!(
+                    "generate-proof successful: {:?}",
+                    results.iter().all(|ok| *ok)
+                );
+            }
         }
         ("print-proof", Some(sub_matches)) => {
             let format = sub_matches.value_of("format").unwrap();
@@ -560,11 +742,26 @@ fn cli() -> Result<(), String> {
 
             let scheme = get_scheme(sub_matches.value_of("proving-scheme").unwrap())?;
             let vk_path = sub_matches.value_of("verifyingkey").unwrap();
-            let proof_path = sub_matches.value_of("proofpath").unwrap();
-            println!(
-                "verify-proof successful: {:?}",
-                scheme.verify_proof(vk_path, proof_path)
-            );
+            let proof_paths: Vec<String> = sub_matches
+                .values_of("proofpath")
+                .unwrap()
+                .map(String::from)
+                .collect();
+            if proof_paths.len() == 1 {
+                println!(
+                    "verify-proof successful: {:?}",
+                    scheme.verify_proof(vk_path, &proof_paths[0])
+                );
+            } else {
+                let results = scheme.verify_proofs(vk_path, &proof_paths);
+                for (proof_path, ok) in proof_paths.iter().zip(&results) {
+                    println!("{}: {:?}", proof_path, ok);
+                }
+                println!(
+                    "verify-proof successful: {:?}",
+                    results.iter().all(|ok| *ok)
+                );
+            }
         }
         ("export-verifier", Some(sub_matches)) => {
             {
@@ -593,17 +790,67 @@ fn cli() -> Result<(), String> {
                 println!("Finished exporting verifier.");
             }
         }
+        ("serve", Some(sub_matches)) => {
+            let scheme = get_scheme(sub_matches.value_of("proving-scheme").unwrap())?;
+            set_threads_from(sub_matches)?;
+            let context = scheme.prover_context();
+            let mut programs = HashMap::new();
+
+            let stdin = stdin();
+            for line in stdin.lock().lines() {
+                let line = line.map_err(|why| format!("couldn't read request: {}", why))?;
+                if line.trim().is_empty() {
+                    continue;
+                }
+                let response = match serve_request(&line, scheme, &context, &mut programs) {
+                    Ok(ok) => json!({ "ok": ok }),
+                    Err(e) => json!({ "ok": false, "error": e }),
+                };
+                println!("{}", response);
+            }
+        }
         #[cfg(feature = "libsnark")]
         ("batch", Some(sub_matches)) => {
+            set_threads_from(sub_matches)?;
+            if let Some(dir) = sub_matches.value_of("keys-dir") {
+                env::set_var("ZOKRATES_AGGREGATOR_KEYS", dir);
+            }
             let fc = sub_matches.value_of("from_curve").unwrap();
-            let f1 = sub_matches.value_of("from_1").unwrap();
-            let f2 = sub_matches.value_of("from_2").unwrap();
             let tc = sub_matches.value_of("to_curve").unwrap();
-            let vk1 = format!("{}/{}", f1, VERIFICATION_KEY_DEFAULT_PATH);
-            let proof1 = format!("{}/{}", f1, JSON_PROOF_PATH);
-            let vk2 = format!("{}/{}", f2, VERIFICATION_KEY_DEFAULT_PATH);
-            let proof2 = format!("{}/{}", f2, JSON_PROOF_PATH);
-            let ok = batch(fc, tc, &vk1, &proof1, &vk2, &proof2, VERIFICATION_KEY_DEFAULT_PATH, JSON_PROOF_PATH);
+            let folders: Vec<&str> = sub_matches
+                .value_of("from_1")
+                .into_iter()
+                .chain(sub_matches.value_of("from_2"))
+                .chain(sub_matches.values_of("from").into_iter().flatten())
+                .collect();
+            let vks: Vec<String> = folders
+                .iter()
+                .map(|f| format!("{}/{}", f, VERIFICATION_KEY_DEFAULT_PATH))
+                .collect();
+            let proofs: Vec<String> = folders
+                .iter()
+                .map(|f| format!("{}/{}", f, JSON_PROOF_PATH))
+                .collect();
+            let ok = if sub_matches.is_present("tree") {
+                let arity: usize = sub_matches
+                    .value_of("arity")
+                    .unwrap()
+                    .parse()
+                    .map_err(|_| "Invalid arity".to_string())?;
+                if arity < 2 {
+                    return Err("Tree aggregation needs an arity of at least 2".to_string());
+                }
+                let depth = tree_depth(folders.len(), arity);
+                println!(
+                    "Aggregating {} proofs in {} layers, final proof on {}",
+                    folders.len(),
+                    depth,
+                    if depth % 2 == 1 { tc } else { fc }
+                );
+                batch_tree(fc, tc, &vks, &proofs, arity, VERIFICATION_KEY_DEFAULT_PATH, JSON_PROOF_PATH)
+            } else {
+                batch_n(fc, tc, &vks, &proofs, VERIFICATION_KEY_DEFAULT_PATH, JSON_PROOF_PATH)
+            };
             println!("batching successful: {:?}", ok);
         }
         _ => unreachable!(),
@@ -611,6 +858,105 @@ fn cli() -> Result<(), String> {
     Ok(())
 }
 
+// applies `--threads` to the libsnark backends
+fn set_threads_from(sub_matches: &ArgMatches) -> Result<(), String> {
+    if let Some(threads) = sub_matches.value_of("threads") {
+        set_threads(
+            threads
+                .parse()
+                .map_err(|_| format!("Invalid thread count: {}", threads))?,
+        );
+    }
+    Ok(())
+}
+
+// a program deserialized by `serve`, with the version of its file and its hash
+struct ServedProgram {
+    version: FileVersion,
+    program: ir::Prog<FieldPrime>,
+    hash: u64,
+}
+
+// size, modification time and inode of a file, which change when it is rewritten or replaced
+#[derive(PartialEq)]
+struct FileVersion {
+    len: u64,
+    modified: SystemTime,
+    inode: u64,
+}
+
+fn file_version(path: &str) -> io::Result<FileVersion> {
+    let metadata = fs::metadata(path)?;
+    #[cfg(unix)]
+    let inode = std::os::unix::fs::MetadataExt::ino(&metadata);
+    #[cfg(not(unix))]
+    let inode = 0;
+    Ok(FileVersion {
+        len: metadata.len(),
+        modified: metadata.modified()?,
+        inode,
+    })
+}
+
+// handles one `serve` request, keeping deserialized programs around for later requests
+// until their file changes
+fn serve_request(
+    request: &str,
+    scheme: &dyn ProofSystem,
+    context: &Option<Box<dyn ProverContext>>,
+    programs: &mut HashMap<String, ServedProgram>,
+) -> Result<bool, String> {
+    let request: Value =
+        serde_json::from_str(request).map_err(|why| format!("invalid request: {}", why))?;
+    let field = |name: &str, default: &'static str| -> Result<String, String> {
+        match request.get(name) {
+            None => Ok(String::from(default)),
+            Some(Value::String(s)) => Ok(s.clone()),
+            Some(_) => Err(format!("`{}` must be a string", name)),
+        }
+    };
+
+    let program_path = field("input", FLATTENED_CODE_DEFAULT_PATH)?;
+    let witness_path = field("witness", WITNESS_DEFAULT_PATH)?;
+    let pk_path = field("provingkey", PROVING_KEY_DEFAULT_PATH)?;
+    let proof_path = field("proofpath", JSON_PROOF_PATH)?;
+
+    let version = file_version(&program_path)
+        .map_err(|why| format!("couldn't open {}: {}", program_path, why))?;
+    if programs
+        .get(&program_path)
+        .map_or(true, |served| served.version != version)
+    {
+        let program_file = File::open(&program_path)
+            .map_err(|why| format!("couldn't open {}: {}", program_path, why))?;
+        let program: ir::Prog<FieldPrime> =
+            deserialize_from(&mut BufReader::new(program_file), Infinite)
+                .map_err(|why| format!("{:?}", why))?;
+        let hash = program_hash(&program);
+        programs.insert(
+            program_path.clone(),
+            ServedProgram {
+                version,
+                program,
+                hash,
+            },
+        );
+    }
+    let served = &programs[&program_path];
+
+    let witness_file = File::open(&witness_path)
+        .map_err(|why| format!("couldn't open {}: {}", witness_path, why))?;
+    let witness = ir::Witness::read(witness_file)
+        .map_err(|why| format!("could not load witness: {:?}", why))?;
+
+    Ok(match context {
+        Some(context) => {
+            context.generate_proof(&served.program, served.hash, witness, &pk_path, &proof_path)
+        }
+        None => scheme.generate_proof(served.program.clone(), witness, &pk_path, &proof_path),
+    })
+}
+
 fn get_scheme(scheme_str: &str) -> Result<&'static dyn ProofSystem, String> {
     match scheme_str.to_lowercase().as_ref() {
         #[cfg(feature = "libsnark")]
@@ -187,6 +187,7 @@ mod integration {
                 verification_key_path.to_str().unwrap(),
                 "--proving-scheme",
                 scheme,
+                "--fresh-keys",
             ])
             .succeeds()
             .unwrap();
@@ -236,6 +237,749 @@ mod integration {
             ])
             .succeeds()
             .unwrap();
+
+            // VERIFY-PROOF, natively verified by the libsnark backends only
+            if *scheme != "g16" {
+                assert_cli::Assert::command(&[
+                    "../target/release/zokrates",
+                    "verify-proof",
+                    "-p",
+                    verification_key_path.to_str().unwrap(),
+                    "--proving-scheme",
+                    scheme,
+                ])
+                .succeeds()
+                .stdout()
+                .contains("verify-proof successful: true")
+                .unwrap();
+            }
+        }
+    }
+
+    #[test]
+    #[ignore]
+    #[cfg(feature = "libsnark")]
+    fn test_proofs_across_thread_counts() {
+        let tmp_dir = TempDir::new(".tmp").unwrap();
+        let tmp_base = tmp_dir.path();
+        let flattened_path = tmp_base.join("out");
+        let witness_path = tmp_base.join("witness");
+        let proving_key_path = tmp_base.join("proving.key");
+        let verification_key_path = tmp_base.join("verification.key");
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compile",
+            "-i",
+            "./tests/code/simple_mul.code",
+            "-o",
+            flattened_path.to_str().unwrap(),
+            "--light",
+        ])
+        .succeeds()
+        .unwrap();
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compute-witness",
+            "-i",
+            flattened_path.to_str().unwrap(),
+            "-o",
+            witness_path.to_str().unwrap(),
+            "-a",
+            "2",
+            "3",
+            "4",
+        ])
+        .succeeds()
+        .unwrap();
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "setup",
+            "-i",
+            flattened_path.to_str().unwrap(),
+            "-p",
+            proving_key_path.to_str().unwrap(),
+            "-v",
+            verification_key_path.to_str().unwrap(),
+            "--proving-scheme",
+            "pghr13",
+            "--threads",
+            "1",
+            "--fresh-keys",
+        ])
+        .succeeds()
+        .unwrap();
+
+        // proofs are randomized, so they can't be compared byte for byte: each one has to
+        // verify against the same key and commit to the same public inputs
+        let mut inputs = vec![];
+        for threads in &["1", "4"] {
+            let proof_path = tmp_base.join(format!("proof_{}.json", threads));
+
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "generate-proof",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-w",
+                witness_path.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "-j",
+                proof_path.to_str().unwrap(),
+                "--proving-scheme",
+                "pghr13",
+                "--threads",
+                threads,
+            ])
+            .succeeds()
+            .unwrap();
+
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "verify-proof",
+                "-p",
+                verification_key_path.to_str().unwrap(),
+                "-j",
+                proof_path.to_str().unwrap(),
+                "--proving-scheme",
+                "pghr13",
+            ])
+            .succeeds()
+            .stdout()
+            .contains("verify-proof successful: true")
+            .unwrap();
+
+            let proof: Value = serde_json::from_reader(File::open(&proof_path).unwrap()).unwrap();
+            inputs.push(proof["input"].clone());
+        }
+
+        assert_eq!(inputs[0], inputs[1]);
+    }
+
+    #[test]
+    #[ignore]
+    #[cfg(feature = "libsnark")]
+    fn test_proofs_from_prepared_keys() {
+        let tmp_dir = TempDir::new(".tmp").unwrap();
+        let tmp_base = tmp_dir.path();
+        let flattened_path = tmp_base.join("out");
+        let witness_path = tmp_base.join("witness");
+        let proving_key_path = tmp_base.join("proving.key");
+        let verification_key_path = tmp_base.join("verification.key");
+        let proof_path = tmp_base.join("proof.json");
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compile",
+            "-i",
+            "./tests/code/simple_mul.code",
+            "-o",
+            flattened_path.to_str().unwrap(),
+            "--light",
+        ])
+        .succeeds()
+        .unwrap();
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compute-witness",
+            "-i",
+            flattened_path.to_str().unwrap(),
+            "-o",
+            witness_path.to_str().unwrap(),
+            "-a",
+            "2",
+            "3",
+            "4",
+        ])
+        .succeeds()
+        .unwrap();
+
+        for scheme in &["pghr13", "gm17"] {
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "setup",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "-v",
+                verification_key_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+                "--light",
+                "--fresh-keys",
+            ])
+            .succeeds()
+            .unwrap();
+
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "prepare-key",
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+                "--window",
+                "4",
+            ])
+            .succeeds()
+            .unwrap();
+
+            // tables prepared from this key file are used without a warning
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "generate-proof",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-w",
+                witness_path.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "-j",
+                proof_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+            ])
+            .succeeds()
+            .stderr()
+            .doesnt_contain("prepared proving key")
+            .unwrap();
+
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "verify-proof",
+                "-p",
+                verification_key_path.to_str().unwrap(),
+                "-j",
+                proof_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+            ])
+            .succeeds()
+            .stdout()
+            .contains("verify-proof successful: true")
+            .unwrap();
+
+            // a new setup replaces the key but leaves its tables behind: they are reported
+            // on stderr and the proof is computed without them
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "setup",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "-v",
+                verification_key_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+                "--light",
+                "--fresh-keys",
+            ])
+            .succeeds()
+            .unwrap();
+
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "generate-proof",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-w",
+                witness_path.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "-j",
+                proof_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+            ])
+            .succeeds()
+            .stderr()
+            .contains("ignoring prepared proving key")
+            .unwrap();
+
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "verify-proof",
+                "-p",
+                verification_key_path.to_str().unwrap(),
+                "-j",
+                proof_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+            ])
+            .succeeds()
+            .stdout()
+            .contains("verify-proof successful: true")
+            .unwrap();
+        }
+    }
+
+    #[test]
+    #[ignore]
+    #[cfg(feature = "libsnark")]
+    fn test_proofs_of_several_witnesses() {
+        let tmp_dir = TempDir::new(".tmp").unwrap();
+        let tmp_base = tmp_dir.path();
+        let flattened_path = tmp_base.join("out");
+        let proving_key_path = tmp_base.join("proving.key");
+        let verification_key_path = tmp_base.join("verification.key");
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compile",
+            "-i",
+            "./tests/code/simple_mul.code",
+            "-o",
+            flattened_path.to_str().unwrap(),
+            "--light",
+        ])
+        .succeeds()
+        .unwrap();
+
+        let arguments = [["2", "3", "4"], ["5", "6", "7"], ["1", "1", "1"]];
+        let witness_paths: Vec<_> = (0..arguments.len())
+            .map(|i| tmp_base.join(format!("witness_{}", i)))
+            .collect();
+        let proof_paths: Vec<_> = (0..arguments.len())
+            .map(|i| tmp_base.join(format!("proof_{}.json", i)))
+            .collect();
+
+        for (args, witness_path) in arguments.iter().zip(&witness_paths) {
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "compute-witness",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-o",
+                witness_path.to_str().unwrap(),
+                "-a",
+                args[0],
+                args[1],
+                args[2],
+            ])
+            .succeeds()
+            .unwrap();
+        }
+
+        for scheme in &["pghr13", "gm17"] {
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "setup",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "-v",
+                verification_key_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+                "--light",
+                "--fresh-keys",
+            ])
+            .succeeds()
+            .unwrap();
+
+            let mut command = vec![
+                "../target/release/zokrates",
+                "generate-proof",
+                "-i",
+                flattened_path.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+                "-w",
+            ];
+            command.extend(witness_paths.iter().map(|p| p.to_str().unwrap()));
+            command.push("-j");
+            command.extend(proof_paths.iter().map(|p| p.to_str().unwrap()));
+            assert_cli::Assert::command(&command)
+                .succeeds()
+                .stdout()
+                .contains("generate-proof successful: true")
+                .unwrap();
+
+            // each proof commits to the inputs of its own witness
+            let mut inputs = vec![];
+            for proof_path in &proof_paths {
+                assert_cli::Assert::command(&[
+                    "../target/release/zokrates",
+                    "verify-proof",
+                    "-p",
+                    verification_key_path.to_str().unwrap(),
+                    "-j",
+                    proof_path.to_str().unwrap(),
+                    "--proving-scheme",
+                    scheme,
+                ])
+                .succeeds()
+                .stdout()
+                .contains("verify-proof successful: true")
+                .unwrap();
+
+                let proof: Value =
+                    serde_json::from_reader(File::open(proof_path).unwrap()).unwrap();
+                inputs.push(proof["input"].clone());
+            }
+            assert_ne!(inputs[0], inputs[1]);
+            assert_ne!(inputs[1], inputs[2]);
+        }
+    }
+
+    // peak RSS of a setup of `program`, from the profile it writes, and the size of its proving key
+    #[cfg(feature = "libsnark")]
+    fn setup_peak_rss_kb(program: &Path, scheme: &str, tmp_base: &Path, name: &str) -> (u64, u64) {
+        let proving_key_path = tmp_base.join(format!("{}.key", name));
+        let verification_key_path = tmp_base.join(format!("{}.vk", name));
+        let profile_dir = tmp_base.join(format!("{}_profile", name));
+
+        let status = std::process::Command::new("../target/release/zokrates")
+            .args(&[
+                "setup",
+                "-i",
+                program.to_str().unwrap(),
+                "-p",
+                proving_key_path.to_str().unwrap(),
+                "-v",
+                verification_key_path.to_str().unwrap(),
+                "--proving-scheme",
+                scheme,
+                "--light",
+                "--fresh-keys",
+            ])
+            .env("ZOKRATES_PROFILE", &profile_dir)
+            .status()
+            .unwrap();
+        assert!(status.success());
+
+        let profile_path = fs::read_dir(&profile_dir)
+            .unwrap()
+            .map(|entry| entry.unwrap().path())
+            .find(|path| {
+                path.file_name()
+                    .unwrap()
+                    .to_str()
+                    .unwrap()
+                    .starts_with(&format!("{}_setup", scheme))
+            })
+            .unwrap();
+        let profile: Value = serde_json::from_reader(File::open(profile_path).unwrap()).unwrap();
+        (
+            profile["peak_rss_kb"].as_u64().unwrap(),
+            fs::metadata(&proving_key_path).unwrap().len(),
+        )
+    }
+
+    #[test]
+    #[ignore]
+    #[cfg(feature = "libsnark")]
+    fn test_setup_memory_bounded_by_key_size() {
+        let tmp_dir = TempDir::new(".tmp").unwrap();
+        let tmp_base = tmp_dir.path();
+        let small_path = tmp_base.join("small");
+        let large_path = tmp_base.join("large");
+
+        for (source, flattened_path) in &[
+            ("./tests/code/simple_mul.code", &small_path),
+            ("./tests/code/sha_round.code", &large_path),
+        ] {
+            assert_cli::Assert::command(&[
+                "../target/release/zokrates",
+                "compile",
+                "-i",
+                *source,
+                "-o",
+                flattened_path.to_str().unwrap(),
+                "--light",
+            ])
+            .succeeds()
+            .unwrap();
+        }
+
+        for scheme in &["pghr13", "gm17"] {
+            // the process itself, with a key small enough not to matter
+            let (baseline_kb, _) = setup_peak_rss_kb(&small_path, scheme, tmp_base, "small");
+            let (peak_kb, key_bytes) = setup_peak_rss_kb(&large_path, scheme, tmp_base, "large");
+
+            // the keypair, the constraint system and the generator's tables, but no
+            // serialized copy of any of them
+            let bound_kb = baseline_kb + 3 * key_bytes / 1024;
+            assert!(
+                peak_kb <= bound_kb,
+                "{} setup peaked at {} kB for a {} kB proving key, above {} kB",
+                scheme,
+                peak_kb,
+                key_bytes / 1024,
+                bound_kb
+            );
         }
     }
+
+    // pghr13 setup of `program` to <tmp_base>/<name>.key and <tmp_base>/<name>.vk, with `store`
+    // as the key store; returns what setup printed
+    #[cfg(feature = "libsnark")]
+    fn setup_with_store(
+        program: &Path,
+        store: &Path,
+        tmp_base: &Path,
+        name: &str,
+        extra: &[&str],
+    ) -> String {
+        let proving_key_path = tmp_base.join(format!("{}.key", name));
+        let verification_key_path = tmp_base.join(format!("{}.vk", name));
+        let mut args = vec![
+            "setup",
+            "-i",
+            program.to_str().unwrap(),
+            "-p",
+            proving_key_path.to_str().unwrap(),
+            "-v",
+            verification_key_path.to_str().unwrap(),
+            "--proving-scheme",
+            "pghr13",
+            "--keys-store",
+            store.to_str().unwrap(),
+        ];
+        args.extend_from_slice(extra);
+
+        let output = std::process::Command::new("../target/release/zokrates")
+            .args(&args)
+            .output()
+            .unwrap();
+        assert!(output.status.success());
+        String::from_utf8(output.stdout).unwrap()
+    }
+
+    #[test]
+    #[ignore]
+    #[cfg(feature = "libsnark")]
+    fn test_setup_reuses_keys_of_identical_constraints() {
+        use std::os::unix::fs::MetadataExt;
+
+        let tmp_dir = TempDir::new(".tmp").unwrap();
+        let tmp_base = tmp_dir.path();
+        let flattened_path = tmp_base.join("simple_mul");
+        let store_path = tmp_base.join("store");
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compile",
+            "-i",
+            "./tests/code/simple_mul.code",
+            "-o",
+            flattened_path.to_str().unwrap(),
+            "--light",
+        ])
+        .succeeds()
+        .unwrap();
+
+        let reused = "reusing the keys of an identical constraint system";
+        assert!(
+            !setup_with_store(&flattened_path, &store_path, tmp_base, "first", &[])
+                .contains(reused)
+        );
+        assert!(
+            setup_with_store(&flattened_path, &store_path, tmp_base, "second", &[])
+                .contains(reused)
+        );
+        assert!(!setup_with_store(
+            &flattened_path,
+            &store_path,
+            tmp_base,
+            "fresh",
+            &["--fresh-keys"]
+        )
+        .contains(reused));
+
+        // the second setup copies the keys of the first, the fresh one has its own; the outputs
+        // are writable files apart from each other and from the store
+        let inode = |name: &str| fs::metadata(tmp_base.join(name)).unwrap().ino();
+        let contents = |name: &str| fs::read(tmp_base.join(name)).unwrap();
+        let readonly = |name: &str| {
+            fs::metadata(tmp_base.join(name))
+                .unwrap()
+                .permissions()
+                .readonly()
+        };
+        assert_ne!(inode("first.key"), inode("second.key"));
+        assert!(!readonly("first.key") && !readonly("second.key"));
+        assert_eq!(contents("first.key"), contents("second.key"));
+        assert_eq!(contents("first.vk"), contents("second.vk"));
+        assert_eq!(contents("first.vk.raw"), contents("second.vk.raw"));
+        assert_ne!(contents("first.vk"), contents("fresh.vk"));
+    }
+
+    #[test]
+    #[ignore]
+    #[cfg(feature = "libsnark")]
+    fn test_sparse_proving_keys() {
+        let tmp_dir = TempDir::new(".tmp").unwrap();
+        let tmp_base = tmp_dir.path();
+        let flattened_path = tmp_base.join("simple_mul");
+        let witness_path = tmp_base.join("witness");
+        let proving_key_path = tmp_base.join("proving.key");
+        let verification_key_path = tmp_base.join("verification.key");
+        let proof_path = tmp_base.join("proof.json");
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compile",
+            "-i",
+            "./tests/code/simple_mul.code",
+            "-o",
+            flattened_path.to_str().unwrap(),
+            "--light",
+        ])
+        .succeeds()
+        .unwrap();
+
+        assert_cli::Assert::command(&[
+            "../target/release/zokrates",
+            "compute-witness",
+            "-i",
+            flattened_path.to_str().unwrap(),
+            "-o",
+            witness_path.to_str().unwrap(),
+            "-a",
+            "2",
+            "3",
+            "4",
+        ])
+        .succeeds()
+        .unwrap();
+
+        // setup reports the points at infinity it left out of the key unless asked for a
+        // dense one, and the provers read either back
+        for scheme in &["pghr13", "gm17"] {
+            for dense in &[false, true] {
+                let mut setup = vec![
+                    "../target/release/zokrates",
+                    "setup",
+                    "-i",
+                    flattened_path.to_str().unwrap(),
+                    "-p",
+                    proving_key_path.to_str().unwrap(),
+                    "-v",
+                    verification_key_path.to_str().unwrap(),
+                    "--proving-scheme",
+                    scheme,
+                    "--fresh-keys",
+                ];
+                if *dense {
+                    setup.push("--dense-keys");
+                }
+                let output = assert_cli::Assert::command(&setup).succeeds().stdout();
+                if *dense {
+                    output.doesnt_contain("at infinity pruned").unwrap();
+                } else {
+                    output.contains("at infinity pruned").unwrap();
+                }
+
+                assert_cli::Assert::command(&[
+                    "../target/release/zokrates",
+                    "generate-proof",
+                    "-i",
+                    flattened_path.to_str().unwrap(),
+                    "-w",
+                    witness_path.to_str().unwrap(),
+                    "-p",
+                    proving_key_path.to_str().unwrap(),
+                    "-j",
+                    proof_path.to_str().unwrap(),
+                    "--proving-scheme",
+                    scheme,
+                ])
+                .succeeds()
+                .unwrap();
+
+                assert_cli::Assert::command(&[
+                    "../target/release/zokrates",
+                    "verify-proof",
+                    "-p",
+                    verification_key_path.to_str().unwrap(),
+                    "-j",
+                    proof_path.to_str().unwrap(),
+                    "--proving-scheme",
+                    scheme,
+                ])
+                .succeeds()
+                .stdout()
+                .contains("verify-proof successful: true")
+                .unwrap();
+            }
+        }
+    }
+
+    // runs the zokrates binary in `dir` with ZOKRATES_CURVE set to `curve`
+    #[cfg(feature = "libsnark")]
+    fn zokrates_on_curve(args: &[&str], curve: &str, dir: &Path) -> std::process::Output {
+        std::process::Command::new(fs::canonicalize("../target/release/zokrates").unwrap())
+            .args(args)
+            .env("ZOKRATES_CURVE", curve)
+            .current_dir(dir)
+            .output()
+            .unwrap()
+    }
+
+    #[test]
+    #[ignore]
+    #[cfg(feature = "libsnark")]
+    fn test_batch_satisfies_aggregator_circuit() {
+        let tmp_dir = TempDir::new(".tmp").unwrap();
+        let tmp_base = tmp_dir.path();
+        let proof_dir = tmp_base.join("proof");
+        fs::create_dir(&proof_dir).unwrap();
+        let program = fs::canonicalize("./tests/code/simple_mul.code").unwrap();
+
+        for args in &[
+            vec!["compile", "-i", program.to_str().unwrap(), "--light"],
+            vec!["compute-witness", "-a", "2", "3", "4"],
+            vec![
+                "setup",
+                "--proving-scheme",
+                "pghr13",
+                "--light",
+                "--fresh-keys",
+            ],
+            vec!["generate-proof", "--proving-scheme", "pghr13"],
+        ] {
+            let output = zokrates_on_curve(args, "MNT4", &proof_dir);
+            assert!(output.status.success(), "{:?} failed", args);
+        }
+
+        // the same MNT4 proof twice, folded into one MNT6 proof; the aggregator fails when its
+        // witness does not satisfy its circuit
+        let output = zokrates_on_curve(
+            &[
+                "batch",
+                "--from_curve",
+                "mnt4",
+                "--to_curve",
+                "mnt6",
+                "--from_1",
+                proof_dir.to_str().unwrap(),
+                "--from_2",
+                proof_dir.to_str().unwrap(),
+                "--keys-dir",
+                "",
+            ],
+            "MNT4",
+            tmp_base,
+        );
+        let stderr = String::from_utf8_lossy(&output.stderr);
+        assert!(!stderr.contains("not satisfied"), "{}", stderr);
+        assert!(String::from_utf8_lossy(&output.stdout).contains("batching successful: true"));
+
+        let output = zokrates_on_curve(
+            &["verify-proof", "--proving-scheme", "pghr13"],
+            "MNT6",
+            tmp_base,
+        );
+        assert!(String::from_utf8_lossy(&output.stdout).contains("verify-proof successful: true"));
+    }
 }
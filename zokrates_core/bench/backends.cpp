@@ -0,0 +1,383 @@
+/**
+ * @file backends.cpp
+ * End-to-end timings of the libsnark backends through their C entry points:
+ * GM17 setup/proof/verification on alt_bn128, PGHR13 setup/proof/verification
+ * on alt_bn128, MNT4 and MNT6, and optionally PGHR13 batching of MNT4 proofs
+ * and N proofs of one key, as N `_generate_proof_limbs` calls and as one
+ * `_generate_proofs_limbs` call.
+ * Circuits are synthetic and satisfiable: every row multiplies a random
+ * combination of `density` earlier variables by one earlier variable into a
+ * new one, in the same VariableValueMapping layout as the Rust side writes.
+ *
+ * usage: zokrates_bench_backends [--sizes 1000,10000] [--density 3] [--inputs 2]
+ *                                [--curves alt_bn128,mnt4,mnt6] [--batch] [--proofs 8]
+ *                                [--out results.json]
+ *        zokrates_bench_backends --compare baseline.json results.json [--threshold 0.1]
+ *
+ * Results are written as JSON, one result per line. Compare mode prints the
+ * ratio of every timing to its baseline and exits with 1 if any of them is
+ * slower by more than the threshold.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+#include "libff/algebra/curves/mnt/mnt4/mnt4_pp.hpp"
+#include "libff/algebra/curves/mnt/mnt6/mnt6_pp.hpp"
+
+#include "../lib/gm17.hpp"
+#include "../lib/pghr13.hpp"
+#include "../lib/util.tcc"
+
+template<mp_size_t R>
+struct variable_value_mapping {
+  int constraint_id;
+  int variable_id;
+  uint8_t variable_value[R*mp_limb_t_size];
+};
+
+template<mp_size_t R>
+void bigEndianBytes(const libff::bigint<R>& x, uint8_t* out)
+{
+  for (unsigned i = 0; i < R; i++)
+    for (unsigned j = 0; j < 8; j++)
+      out[i * 8 + j] = uint8_t(uint64_t(x.data[R - 1 - i]) >> (8 * (7 - j)));
+}
+
+template<mp_size_t R, typename FieldT>
+struct synthetic_circuit {
+  std::vector<variable_value_mapping<R>> A, B, C;
+  std::vector<uint8_t> public_inputs, private_inputs;
+  std::vector<uint64_t> limbs;
+  int constraints, variables, inputs;
+
+  synthetic_circuit(int constraints, int density, int inputs, std::mt19937_64& rng)
+    : constraints(constraints), variables(1 + inputs + constraints), inputs(inputs)
+  {
+    std::vector<FieldT> values(variables);
+    values[0] = FieldT::one();
+    for (int i = 1; i <= inputs; i++)
+      values[i] = FieldT(rng() >> 1);
+
+    for (int row = 0; row < constraints; row++) {
+      const int out = 1 + inputs + row;
+      FieldT a = FieldT::zero();
+      for (int t = 0; t < density; t++) {
+        const int var = rng() % out;
+        const FieldT coefficient(1 + rng() % 65535);
+        a += coefficient * values[var];
+        push(A, row, var, coefficient);
+      }
+      const int factor = rng() % out;
+      push(B, row, factor, FieldT::one());
+      push(C, row, out, FieldT::one());
+      values[out] = a * values[factor];
+    }
+
+    public_inputs.resize((1 + inputs) * R * mp_limb_t_size);
+    private_inputs.resize(std::max(constraints, 1) * R * mp_limb_t_size);
+    for (int i = 0; i < variables; i++) {
+      uint8_t* out = i <= inputs
+        ? public_inputs.data() + i * R * mp_limb_t_size
+        : private_inputs.data() + (i - 1 - inputs) * R * mp_limb_t_size;
+      bigEndianBytes<R>(values[i].as_bigint(), out);
+    }
+
+    limbs.resize(variables * R);
+    for (int i = 0; i < variables; i++) {
+      const libff::bigint<R> value = values[i].as_bigint();
+      for (unsigned j = 0; j < R; j++)
+        limbs[i * R + j] = value.data[j];
+    }
+  }
+
+  static void push(std::vector<variable_value_mapping<R>>& rows, int row, int var, const FieldT& value)
+  {
+    variable_value_mapping<R> m;
+    m.constraint_id = row;
+    m.variable_id = var;
+    bigEndianBytes<R>(value.as_bigint(), m.variable_value);
+    rows.push_back(m);
+  }
+};
+
+struct bench_result {
+  std::string name;
+  double seconds;
+};
+
+template<typename F>
+static double seconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string resultName(const char* scheme, const char* curve, const char* step, int constraints, int density)
+{
+  return std::string(scheme) + "/" + curve + "/" + step + "/" + std::to_string(constraints) + "x" + std::to_string(density);
+}
+
+typedef bool (*setup_fn)(const uint8_t*, const uint8_t*, const uint8_t*, int, int, int, int, int, int, const char*, const char*, int);
+typedef bool (*prove_fn)(const char*, const char*, const uint8_t*, int, const uint8_t*, int, int);
+typedef bool (*verify_fn)(const char*, const char*);
+typedef bool (*prove_limbs_fn)(const char*, const char*, uint64_t*, int, int, int);
+typedef bool (*prove_many_fn)(const char*, const char* const*, uint64_t* const*, int, int, int, bool*, int);
+
+template<mp_size_t R, typename FieldT>
+static bool benchScheme(const synthetic_circuit<R, FieldT>& circuit, const char* scheme, const char* curve, int density,
+    setup_fn setup, prove_fn prove, verify_fn verify, const std::string& dir, std::vector<bench_result>& results)
+{
+  const std::string prefix = dir + "/" + scheme + "_" + curve + "_" + std::to_string(circuit.constraints);
+  const std::string pk = prefix + ".pk", vk = prefix + ".vk", proof = prefix + ".proof.json";
+  bool ok = true;
+
+  results.push_back({ resultName(scheme, curve, "setup", circuit.constraints, density), seconds([&] {
+    ok = setup((const uint8_t*) circuit.A.data(), (const uint8_t*) circuit.B.data(), (const uint8_t*) circuit.C.data(),
+        circuit.A.size(), circuit.B.size(), circuit.C.size(), circuit.constraints, circuit.variables, circuit.inputs,
+        pk.c_str(), vk.c_str(), 0);
+  }) });
+  if (!ok)
+    return false;
+
+  results.push_back({ resultName(scheme, curve, "prove", circuit.constraints, density), seconds([&] {
+    ok = prove(pk.c_str(), proof.c_str(), circuit.public_inputs.data(), circuit.inputs + 1,
+        circuit.private_inputs.data(), circuit.constraints, 0);
+  }) });
+  if (!ok)
+    return false;
+
+  results.push_back({ resultName(scheme, curve, "verify", circuit.constraints, density), seconds([&] {
+    ok = verify(vk.c_str(), proof.c_str());
+  }) });
+  if (!ok)
+    std::cerr << scheme << "/" << curve << ": proof of the synthetic circuit did not verify" << std::endl;
+  return ok;
+}
+
+// `count` proofs of the circuit against the key benchScheme wrote, one call each and then all
+// in one call; the witnesses are copied beforehand since the provers overwrite them
+template<mp_size_t R, typename FieldT>
+static bool benchProofs(const synthetic_circuit<R, FieldT>& circuit, const char* scheme, const char* curve, int density, int count,
+    prove_limbs_fn prove, prove_many_fn prove_many, const std::string& dir, std::vector<bench_result>& results)
+{
+  const std::string prefix = dir + "/" + scheme + "_" + curve + "_" + std::to_string(circuit.constraints);
+  const std::string pk = prefix + ".pk";
+  std::vector<std::string> proofs(count);
+  std::vector<const char*> proof_paths(count);
+  std::vector<std::vector<uint64_t>> witnesses(count, circuit.limbs);
+  std::vector<uint64_t*> witness_pointers(count);
+  for (int i = 0; i < count; i++) {
+    proofs[i] = prefix + ".proof" + std::to_string(i) + ".json";
+    proof_paths[i] = proofs[i].c_str();
+    witness_pointers[i] = witnesses[i].data();
+  }
+  const std::string step = "prove" + std::to_string(count);
+  bool ok = true;
+
+  results.push_back({ resultName(scheme, curve, (step + "_sequential").c_str(), circuit.constraints, density), seconds([&] {
+    for (int i = 0; i < count && ok; i++)
+      ok = prove(pk.c_str(), proof_paths[i], witness_pointers[i], circuit.inputs + 1, circuit.variables, 0);
+  }) });
+  if (!ok)
+    return false;
+
+  for (std::vector<uint64_t>& witness : witnesses)
+    witness = circuit.limbs;
+  std::unique_ptr<bool[]> written(new bool[count]);
+  results.push_back({ resultName(scheme, curve, (step + "_batch").c_str(), circuit.constraints, density), seconds([&] {
+    ok = prove_many(pk.c_str(), proof_paths.data(), witness_pointers.data(), count, circuit.inputs + 1, circuit.variables, written.get(), 0);
+  }) });
+  if (!ok)
+    std::cerr << scheme << "/" << curve << ": batch proving of the synthetic circuit failed" << std::endl;
+  return ok;
+}
+
+static bool writeResults(const std::string& path, const std::vector<bench_result>& results)
+{
+  std::ofstream fh(path);
+  fh << "{\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    char seconds[32];
+    snprintf(seconds, sizeof(seconds), "%.6f", results[i].seconds);
+    fh << "    {\"name\": \"" << results[i].name << "\", \"seconds\": " << seconds << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  fh << "  ]\n}\n";
+  return fh.good();
+}
+
+// reads back the one-result-per-line files written above
+static bool readResults(const std::string& path, std::map<std::string, double>& results)
+{
+  std::ifstream fh(path);
+  if (!fh.is_open()) {
+    std::cerr << "cannot read " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(fh, line)) {
+    const size_t name = line.find("\"name\": \"");
+    const size_t time = line.find("\"seconds\": ");
+    if (name == std::string::npos || time == std::string::npos)
+      continue;
+    const size_t start = name + strlen("\"name\": \"");
+    results[line.substr(start, line.find('"', start) - start)] = atof(line.c_str() + time + strlen("\"seconds\": "));
+  }
+  return true;
+}
+
+static int compare(const std::string& baseline_path, const std::string& current_path, double threshold)
+{
+  std::map<std::string, double> baseline, current;
+  if (!readResults(baseline_path, baseline) || !readResults(current_path, current))
+    return 2;
+
+  int regressions = 0;
+  for (const auto& result : current) {
+    auto base = baseline.find(result.first);
+    if (base == baseline.end()) {
+      printf("%-48s %10.3fs  (no baseline)\n", result.first.c_str(), result.second);
+      continue;
+    }
+    const double ratio = result.second / base->second;
+    const bool regressed = ratio > 1 + threshold;
+    regressions += regressed;
+    printf("%-48s %10.3fs  %10.3fs  x%.2f%s\n", result.first.c_str(), base->second, result.second, ratio, regressed ? "  REGRESSION" : "");
+  }
+  printf("%d regression(s) beyond %.0f%%\n", regressions, threshold * 100);
+  return regressions > 0 ? 1 : 0;
+}
+
+static std::vector<std::string> split(const std::string& list)
+{
+  std::vector<std::string> items;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<int> sizes = { 1000, 10000 };
+  std::vector<std::string> curves = { "alt_bn128", "mnt4", "mnt6" };
+  int density = 3;
+  int inputs = 2;
+  bool batch = false;
+  int proofs = 0;
+  std::string out = "backends.json";
+  double threshold = 0.1;
+  std::vector<std::string> compared;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--sizes" && has_value) {
+      sizes.clear();
+      for (const std::string& size : split(argv[++i]))
+        sizes.push_back(atoi(size.c_str()));
+    } else if (arg == "--curves" && has_value) {
+      curves = split(argv[++i]);
+    } else if (arg == "--density" && has_value) {
+      density = atoi(argv[++i]);
+    } else if (arg == "--inputs" && has_value) {
+      inputs = atoi(argv[++i]);
+    } else if (arg == "--batch") {
+      batch = true;
+    } else if (arg == "--proofs" && has_value) {
+      proofs = atoi(argv[++i]);
+    } else if (arg == "--out" && has_value) {
+      out = argv[++i];
+    } else if (arg == "--threshold" && has_value) {
+      threshold = atof(argv[++i]);
+    } else if (arg == "--compare" && i + 2 < argc) {
+      compared = { argv[i + 1], argv[i + 2] };
+      i += 2;
+    } else {
+      fprintf(stderr, "unknown or incomplete argument %s\n", arg.c_str());
+      return 2;
+    }
+  }
+
+  if (!compared.empty())
+    return compare(compared[0], compared[1], threshold);
+
+  char dir_template[] = "/tmp/zokrates_bench_XXXXXX";
+  if (mkdtemp(dir_template) == nullptr) {
+    perror("mkdtemp");
+    return 2;
+  }
+  const std::string dir = dir_template;
+
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  libff::mnt4_pp::init_public_params();
+  libff::mnt6_pp::init_public_params();
+
+  std::mt19937_64 rng(42);
+  std::vector<bench_result> results;
+  bool ok = true;
+
+  for (int size : sizes) {
+    for (const std::string& curve : curves) {
+      if (curve == "alt_bn128") {
+        synthetic_circuit<libff::alt_bn128_r_limbs, libff::Fr<libff::alt_bn128_pp>> circuit(size, density, inputs, rng);
+        ok = ok && benchScheme(circuit, "gm17", "alt_bn128", density, _gm17_setup, _gm17_generate_proof, _gm17_verify_proof, dir, results);
+        ok = ok && benchScheme(circuit, "pghr13", "alt_bn128", density, _pghr13_setup, _pghr13_generate_proof, _pghr13_verify_proof, dir, results);
+        if (proofs > 0) {
+          ok = ok && benchProofs(circuit, "gm17", "alt_bn128", density, proofs, _gm17_generate_proof_limbs, _gm17_generate_proofs_limbs, dir, results);
+          ok = ok && benchProofs(circuit, "pghr13", "alt_bn128", density, proofs, _pghr13_generate_proof_limbs, _pghr13_generate_proofs_limbs, dir, results);
+        }
+      } else if (curve == "mnt4") {
+        synthetic_circuit<libff::mnt4_r_limbs, libff::Fr<libff::mnt4_pp>> circuit(size, density, inputs, rng);
+        ok = ok && benchScheme(circuit, "pghr13", "mnt4", density, _pghr13_mnt4_setup, _pghr13_mnt4_generate_proof, _pghr13_mnt4_verify_proof, dir, results);
+      } else if (curve == "mnt6") {
+        synthetic_circuit<libff::mnt6_r_limbs, libff::Fr<libff::mnt6_pp>> circuit(size, density, inputs, rng);
+        ok = ok && benchScheme(circuit, "pghr13", "mnt6", density, _pghr13_mnt6_setup, _pghr13_mnt6_generate_proof, _pghr13_mnt6_verify_proof, dir, results);
+      } else {
+        fprintf(stderr, "unknown curve %s\n", curve.c_str());
+        return 2;
+      }
+    }
+
+    if (batch && ok) {
+      // two copies of the MNT4 proof of this size, folded into one MNT6 proof
+      const std::string prefix = dir + "/pghr13_mnt4_" + std::to_string(size);
+      if (access((prefix + ".proof.json.raw").c_str(), F_OK) != 0) {
+        fprintf(stderr, "--batch needs the mnt4 curve\n");
+        return 2;
+      }
+      const std::string vk = prefix + ".vk", proof = prefix + ".proof.json";
+      const char* vk_paths[] = { vk.c_str(), vk.c_str() };
+      const char* proof_paths[] = { proof.c_str(), proof.c_str() };
+      const std::string agg_vk = dir + "/agg.vk", agg_proof = dir + "/agg.proof.json";
+      results.push_back({ resultName("pghr13", "mnt4_mnt6", "batch2", size, density), seconds([&] {
+        ok = _pghr13_mnt4_mnt6_batch_n(vk_paths, proof_paths, 2, agg_vk.c_str(), agg_proof.c_str(), 0);
+      }) });
+    }
+  }
+
+  if (!writeResults(out, results)) {
+    fprintf(stderr, "cannot write %s\n", out.c_str());
+    return 2;
+  }
+  printf("wrote %zu results to %s (keys and proofs in %s)\n", results.size(), out.c_str(), dir.c_str());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file boolean_scalars.cpp
+ * Multi-exponentiation over alt_bn128 G1 and G2 bases with scalars shaped
+ * like the witnesses of SHA-256 and bit decompositions: a given share of them
+ * zeros and ones, the rest random. Compares libff's BDLO12 method, as the GM17
+ * prover runs it, with the zero/one partition the provers now do, and checks
+ * both results agree.
+ *
+ * usage: zokrates_bench_boolean_scalars [bases] [boolean_share,...]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+#include "libff/algebra/scalar_multiplication/multiexp.hpp"
+
+#include "../lib/prover.tcc"
+
+typedef libff::alt_bn128_pp ppT;
+typedef libff::Fr<ppT> Fr;
+
+template<typename F>
+static double seconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// `share` of the scalars are bits, half of them ones
+static std::vector<Fr> witnessScalars(size_t count, double share)
+{
+  std::vector<Fr> scalars(count);
+  for (size_t i = 0; i < count; i++) {
+    if (rand() < share * RAND_MAX)
+      scalars[i] = rand() % 2 ? Fr::one() : Fr::zero();
+    else
+      scalars[i] = Fr::random_element();
+  }
+  return scalars;
+}
+
+template<typename GT>
+static bool bench(const char* group, size_t count, double share)
+{
+  std::vector<GT> bases(count);
+  for (size_t i = 0; i < count; i++)
+    bases[i] = Fr::random_element() * GT::one();
+  GT::batch_to_special_all_non_zeros(bases);
+  const std::vector<Fr> scalars = witnessScalars(count, share);
+
+#ifdef MULTICORE
+  const size_t chunks = omp_get_max_threads();
+#else
+  const size_t chunks = 1;
+#endif
+  GT expected, result;
+  const double plain = seconds([&] {
+    expected = libff::multi_exp<GT, Fr, libff::multi_exp_method_BDLO12>(bases.begin(), bases.end(), scalars.begin(), scalars.end(), chunks);
+  });
+  const double partitioned = seconds([&] { result = partitionedMultiExp(keyBases(bases), 0, scalars.data(), count); });
+
+  const bool ok = result == expected;
+  printf("%s bases=%zu boolean_share=%.2f bdlo12_seconds=%.3f partitioned_seconds=%.3f speedup=%.2f%s\n",
+      group, count, share, plain, partitioned, plain / partitioned, ok ? "" : " MISMATCH");
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  const size_t count = argc > 1 ? atol(argv[1]) : 1 << 18;
+  // a SHA-256 compression is almost only bits; 0.95 is typical of the programs using it
+  std::vector<double> shares = { 0, 0.5, 0.95 };
+  if (argc > 2) {
+    shares.clear();
+    std::stringstream ss(argv[2]);
+    std::string share;
+    while (std::getline(ss, share, ','))
+      shares.push_back(atof(share.c_str()));
+  }
+
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  ppT::init_public_params();
+
+  for (double share : shares) {
+    if (!bench<libff::G1<ppT>>("G1", count, share) || !bench<libff::G2<ppT>>("G2", count, share)) {
+      fprintf(stderr, "partitioned multi-exponentiation does not match BDLO12\n");
+      return 1;
+    }
+  }
+  return 0;
+}
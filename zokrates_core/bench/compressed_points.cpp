@@ -0,0 +1,104 @@
+/**
+ * @file compressed_points.cpp
+ * File size and load time of proving key points in the plain, compressed,
+ * sparse and sparse compressed binary formats, for alt_bn128 G1 and G2 vectors
+ * of 10^4 points up to the given count, the given share of them at infinity.
+ * Load times are measured from a warm page cache, at one thread and at the
+ * default thread count; the estimate adds the time to read the file at the
+ * given bandwidth, as on a network volume.
+ *
+ * usage: zokrates_bench_compressed_points [max_points] [MB_per_second] [zero_share]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+
+#include "../lib/binary_format.tcc"
+
+typedef libff::alt_bn128_pp ppT;
+
+template<typename F>
+static double seconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename GT>
+static bool loadPoints(const std::string& path, uint32_t flags, std::vector<GT>& points)
+{
+  mapped_file file(path);
+  binary_reader reader(file.data(), file.size());
+  return file.is_open() && readQuery(reader, points, flags) && reader.at_end();
+}
+
+static const char* formatName(uint32_t flags)
+{
+  const char* names[] = { "plain", "compressed", "sparse", "sparse_compressed" };
+  return names[flags];
+}
+
+template<typename GT>
+static bool bench(const char* group, size_t count, double bandwidth, double zero_share)
+{
+  std::vector<GT> points(count);
+  points[0] = GT::one();
+  for (size_t i = 1; i < count; i++)
+    points[i] = points[i - 1] + GT::one();
+  GT::batch_to_special_all_non_zeros(points);
+  points[count / 2] = GT::zero();
+  for (size_t i = 0; i < count; i++) {
+    if (rand() < zero_share * RAND_MAX)
+      points[i] = GT::zero();
+  }
+
+  for (uint32_t flags = 0; flags <= (BINARY_FORMAT_COMPRESSED_POINTS | BINARY_FORMAT_SPARSE_QUERIES); flags++) {
+    const std::string path = std::string("/tmp/zokrates_bench_points_") + group + "." + formatName(flags);
+    binary_writer writer(path);
+    writeQuery(writer, points, flags);
+    if (!writer.close())
+      return false;
+
+    std::vector<GT> loaded;
+    setThreads(1);
+    const double single = seconds([&] { loadPoints(path, flags, loaded); });
+    setThreads(0);
+    bool ok = true;
+    const double parallel = seconds([&] { ok = loadPoints(path, flags, loaded); });
+    ok = ok && loaded == points;
+
+    const double megabytes = mapped_file(path).size() / 1e6;
+    printf("%s points=%zu zero_share=%.2f format=%s size_mb=%.1f load_seconds_1_thread=%.3f load_seconds=%.3f estimated_seconds_at_%.0f_mb_s=%.3f%s\n",
+        group, count, zero_share, formatName(flags), megabytes, single, parallel,
+        bandwidth, megabytes / bandwidth + parallel, ok ? "" : " MISMATCH");
+    remove(path.c_str());
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  const size_t max_points = argc > 1 ? atol(argv[1]) : 1000000;
+  const double bandwidth = argc > 2 ? atof(argv[2]) : 200;
+  const double zero_share = argc > 3 ? atof(argv[3]) : 0.3;
+
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  ppT::init_public_params();
+
+  for (size_t count = 10000; count <= max_points; count *= 10) {
+    if (!bench<libff::G1<ppT>>("G1", count, bandwidth, zero_share) || !bench<libff::G2<ppT>>("G2", count, bandwidth, zero_share)) {
+      fprintf(stderr, "points did not round-trip\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file fixed_base.cpp
+ * Multi-exponentiation over alt_bn128 G1 and G2 bases with libff's BDLO12
+ * method, as the provers run it, and over the fixed-base tables of a prepared
+ * proving key, for 10^3 bases up to the given count. Also reports the table
+ * size relative to the bases, and checks both results agree.
+ *
+ * usage: zokrates_bench_fixed_base [max_bases] [window]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+#include "libff/algebra/scalar_multiplication/multiexp.hpp"
+
+#include "../lib/prover.tcc"
+
+typedef libff::alt_bn128_pp ppT;
+typedef libff::Fr<ppT> Fr;
+
+template<typename F>
+static double seconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename GT>
+static bool bench(const char* group, size_t count, size_t window)
+{
+  std::vector<GT> bases(count);
+  std::vector<Fr> scalars(count);
+  for (size_t i = 0; i < count; i++) {
+    bases[i] = Fr::random_element() * GT::one();
+    scalars[i] = Fr::random_element();
+  }
+  GT::batch_to_special_all_non_zeros(bases);
+
+  const std::string path = std::string("/tmp/zokrates_bench_fixed_base_") + group;
+  binary_writer writer(path);
+  const double preparation = seconds([&] {
+    writeFixedBaseTable<GT>(writer, count, Fr::size_in_bits(), window, [&](size_t i) { return bases[i]; });
+  });
+  if (!writer.close())
+    return false;
+
+  mapped_file file(path);
+  binary_reader reader(file.data(), file.size());
+  fixed_base_table<GT> table;
+  if (!file.is_open() || !readFixedBaseTable(reader, table) || !reader.at_end())
+    return false;
+
+#ifdef MULTICORE
+  const size_t chunks = omp_get_max_threads();
+#else
+  const size_t chunks = 1;
+#endif
+  GT expected, result;
+  const double plain = seconds([&] {
+    expected = libff::multi_exp<GT, Fr, libff::multi_exp_method_BDLO12>(bases.begin(), bases.end(), scalars.begin(), scalars.end(), chunks);
+  });
+  const double tables = seconds([&] { result = fixedBaseMultiExp(table, 0, scalars.data(), count); });
+
+  const bool ok = result == expected;
+  printf("%s bases=%zu window=%zu table_mb=%.1f table_to_bases=%.1f prepare_seconds=%.3f bdlo12_seconds=%.3f table_seconds=%.3f speedup=%.2f%s\n",
+      group, count, (size_t) table.window, file.size() / 1e6, (double) file.size() / (count * sizeof(GT)),
+      preparation, plain, tables, plain / tables, ok ? "" : " MISMATCH");
+  remove(path.c_str());
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  const size_t max_bases = argc > 1 ? atol(argv[1]) : 1000000;
+  const size_t window = argc > 2 ? atol(argv[2]) : 0;
+
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  ppT::init_public_params();
+
+  for (size_t count = 1000; count <= max_bases; count *= 10) {
+    if (!bench<libff::G1<ppT>>("G1", count, window) || !bench<libff::G2<ppT>>("G2", count, window)) {
+      fprintf(stderr, "fixed-base multi-exponentiation does not match BDLO12\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file hex.cpp
+ * Hex serialization of alt_bn128 points: the table-driven text_buffer path of
+ * util.tcc against the stringstream path it replaced, on field elements and on
+ * a vk-shaped text with one G1 line per IC entry. Both paths must agree.
+ *
+ * usage: zokrates_bench_hex [points]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+
+#include "../lib/util.tcc"
+
+typedef libff::alt_bn128_pp ppT;
+typedef libff::alt_bn128_G1 G1T;
+const mp_size_t Q = libff::alt_bn128_q_limbs;
+
+// the previous encoder, kept as the baseline
+template<mp_size_t N>
+std::string streamHexString(libff::bigint<N> _x)
+{
+  uint8_t x[mp_limb_t_size * N];
+  for (unsigned i = 0; i < N; i++)
+    for (unsigned j = 0; j < 8; j++)
+      x[i * 8 + j] = uint8_t(uint64_t(_x.data[N - 1 - i]) >> (8 * (7 - j)));
+
+  std::stringstream ss;
+  ss << std::setfill('0');
+  for (unsigned i = 0; i < mp_limb_t_size * N; i++) {
+    ss << std::hex << std::setw(2) << (int)x[i];
+  }
+  return ss.str();
+}
+
+static std::string streamVk(const std::vector<G1T>& points)
+{
+  std::stringstream ss;
+  ss << "\t\tvk.IC.len() = " << points.size() << std::endl;
+  for (size_t i = 0; i < points.size(); i++) {
+    G1T aff = points[i];
+    aff.to_affine_coordinates();
+    ss << "\t\tvk.IC[" << i << "] = " << "0x" + streamHexString<Q>(aff.X.as_bigint()) + ", 0x" + streamHexString<Q>(aff.Y.as_bigint()) << std::endl;
+  }
+  return ss.str();
+}
+
+static std::string bufferVk(const std::vector<G1T>& points)
+{
+  text_buffer out((points.size() + 1) * (32 + 2 * hexLength<Q>()));
+  out << "\t\tvk.IC.len() = " << points.size() << "\n";
+  for (size_t i = 0; i < points.size(); i++) {
+    out << "\t\tvk.IC[" << i << "] = ";
+    appendPointG1AffineAsHex<Q, G1T>(out, points[i], false);
+    out << "\n";
+  }
+  return out.take();
+}
+
+template<typename F>
+static double seconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+  const int points = argc > 1 ? atoi(argv[1]) : 1 << 14;
+
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  ppT::init_public_params();
+
+  std::vector<G1T> g1(points);
+  std::vector<libff::bigint<Q>> elements(points);
+  for (int i = 0; i < points; i++) {
+    g1[i] = G1T::random_element();
+    g1[i].to_affine_coordinates();
+    elements[i] = g1[i].X.as_bigint();
+  }
+
+  size_t checksum = 0;
+  double stream_elements = seconds([&] {
+    for (const auto& x : elements)
+      checksum += streamHexString<Q>(x).size();
+  });
+  double buffer_elements = seconds([&] {
+    for (const auto& x : elements)
+      checksum += HexStringFromLibsnarkBigint<Q>(x).size();
+  });
+
+  std::string stream_text, buffer_text;
+  double stream_vk = seconds([&] { stream_text = streamVk(g1); });
+  double buffer_vk = seconds([&] { buffer_text = bufferVk(g1); });
+
+  if (stream_text != buffer_text) {
+    fprintf(stderr, "text_buffer output differs from the stringstream output\n");
+    return 1;
+  }
+
+  printf("elements=%d stream_seconds=%.3f buffer_seconds=%.3f speedup=%.1f\n",
+      points, stream_elements, buffer_elements, stream_elements / buffer_elements);
+  printf("vk_points=%d stream_seconds=%.3f buffer_seconds=%.3f speedup=%.1f bytes=%zu\n",
+      points, stream_vk, buffer_vk, stream_vk / buffer_vk, buffer_text.size());
+  return checksum == 0;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file r1cs_builder.cpp
+ * Rows per second and heap allocations of r1cs_builder at 1, 4 and 16
+ * threads, on synthetic alt_bn128 rows shaped like compiled programs (3 terms
+ * in A and B, 1 in C). The same rows are first built the way the backends
+ * used to, one linear combination grown term by term and copied into the
+ * constraint system per row, as a baseline.
+ *
+ * usage: zokrates_bench_r1cs_builder [rows]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+
+#include "../lib/r1cs_builder.tcc"
+
+typedef libff::alt_bn128_pp ppT;
+const mp_size_t R = libff::alt_bn128_r_limbs;
+
+struct VariableValueMapping {
+  int constraint_id;
+  int variable_id;
+  uint8_t variable_value[R*mp_limb_t_size];
+};
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+  allocations++;
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+static std::vector<VariableValueMapping> syntheticRows(int rows, int terms_per_row, int variables)
+{
+  std::vector<VariableValueMapping> v(rows * terms_per_row);
+  for (int row = 0; row < rows; row++) {
+    for (int t = 0; t < terms_per_row; t++) {
+      VariableValueMapping& m = v[row * terms_per_row + t];
+      m.constraint_id = row;
+      m.variable_id = (row * 7 + t * 13) % variables;
+      memset(m.variable_value, 0, sizeof(m.variable_value));
+      // big-endian values below the modulus
+      for (size_t i = 8; i < sizeof(m.variable_value); i++)
+        m.variable_value[i] = (uint8_t) rand();
+    }
+  }
+  return v;
+}
+
+static void addTerms(const std::vector<VariableValueMapping>& v, size_t& id, int row, libsnark::linear_combination<libff::Fr<ppT>>& lin_comb)
+{
+  for (; id < v.size() && v[id].constraint_id == row; id++) {
+    libff::bigint<R> value = libsnarkBigintFromBytes<R>(v[id].variable_value);
+    if (!value.is_zero())
+      lin_comb.add_term(v[id].variable_id, value);
+  }
+}
+
+// one row at a time, as createConstraintSystem did before r1cs_builder
+static void buildGrowing(const std::vector<VariableValueMapping>& A, const std::vector<VariableValueMapping>& B,
+    const std::vector<VariableValueMapping>& C, int rows, int variables, libsnark::r1cs_constraint_system<libff::Fr<ppT>>& cs)
+{
+  cs.primary_input_size = 0;
+  cs.auxiliary_input_size = variables - 1;
+  size_t a = 0, b = 0, c = 0;
+  for (int row = 0; row < rows; row++) {
+    libsnark::linear_combination<libff::Fr<ppT>> lin_comb_A, lin_comb_B, lin_comb_C;
+    addTerms(A, a, row, lin_comb_A);
+    addTerms(B, b, row, lin_comb_B);
+    addTerms(C, c, row, lin_comb_C);
+    cs.add_constraint(libsnark::r1cs_constraint<libff::Fr<ppT>>(lin_comb_A, lin_comb_B, lin_comb_C));
+  }
+}
+
+static void report(const char* builder, int threads, int rows, double seconds, size_t allocated)
+{
+  printf("builder=%s threads=%d rows=%d seconds=%.3f rows_per_second=%.0f allocations=%zu allocations_per_row=%.2f\n",
+      builder, threads, rows, seconds, rows / seconds, allocated, (double) allocated / rows);
+}
+
+int main(int argc, char** argv)
+{
+  const int rows = argc > 1 ? atoi(argv[1]) : 1 << 20;
+  const int variables = rows + 1;
+
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  ppT::init_public_params();
+
+  std::vector<VariableValueMapping> A = syntheticRows(rows, 3, variables);
+  std::vector<VariableValueMapping> B = syntheticRows(rows, 3, variables);
+  std::vector<VariableValueMapping> C = syntheticRows(rows, 1, variables);
+
+  {
+    libsnark::r1cs_constraint_system<libff::Fr<ppT>> cs;
+    const size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    buildGrowing(A, B, C, rows, variables, cs);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report("growing", 1, rows, seconds, allocations - before);
+  }
+
+  for (int threads : { 1, 4, 16 }) {
+    setThreads(threads);
+    const size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    r1cs_builder<R, libff::Fr<ppT>> builder(rows, variables, 0);
+    bool ok = builder.add_rows((const uint8_t*) A.data(), (const uint8_t*) B.data(), (const uint8_t*) C.data(),
+        A.size(), B.size(), C.size(), rows);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!ok || !builder.complete()) {
+      fprintf(stderr, "building failed at %d threads\n", threads);
+      return 1;
+    }
+    report("r1cs_builder", threads, rows, seconds, allocations - before);
+  }
+  return 0;
+}
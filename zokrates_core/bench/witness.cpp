@@ -0,0 +1,95 @@
+/**
+ * @file witness.cpp
+ * Time to turn a marshalled alt_bn128 witness into the prover's primary and
+ * auxiliary inputs, at 10^5 to 10^7 variables: the previous push_back path
+ * over big-endian bytes, the byte path of witness.tcc, and the in-place limb
+ * path of witness.tcc. All three must produce the same inputs.
+ *
+ * usage: zokrates_bench_witness [max_variables]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+
+#include "../lib/witness.tcc"
+
+typedef libff::alt_bn128_pp ppT;
+typedef libff::Fr<ppT> FieldT;
+const mp_size_t R = libff::alt_bn128_r_limbs;
+const int PUBLIC_INPUTS = 16;
+
+// the previous marshalling, kept as the baseline
+static void pushBackWitness(const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length,
+    libsnark::r1cs_primary_input<FieldT>& primary_input, libsnark::r1cs_auxiliary_input<FieldT>& auxiliary_input)
+{
+  libsnark::r1cs_variable_assignment<FieldT> full_variable_assignment;
+  for (int i = 1; i < public_inputs_length; i++) {
+    full_variable_assignment.push_back(FieldT(libsnarkBigintFromBytes<R>(public_inputs + i*R*mp_limb_t_size)));
+  }
+  for (int i = 0; i < private_inputs_length; i++) {
+    full_variable_assignment.push_back(FieldT(libsnarkBigintFromBytes<R>(private_inputs + i*R*mp_limb_t_size)));
+  }
+  primary_input = libsnark::r1cs_primary_input<FieldT>(full_variable_assignment.begin(), full_variable_assignment.begin() + public_inputs_length - 1);
+  auxiliary_input = libsnark::r1cs_auxiliary_input<FieldT>(full_variable_assignment.begin() + public_inputs_length - 1, full_variable_assignment.end());
+}
+
+template<typename F>
+static double seconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+  const int max_variables = argc > 1 ? atoi(argv[1]) : 10000000;
+
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  ppT::init_public_params();
+
+  for (int variables = 100000; variables <= max_variables; variables *= 10) {
+    // the same random values below the modulus in both layouts
+    std::vector<uint64_t> limbs(variables * R);
+    std::vector<uint8_t> bytes(variables * R * mp_limb_t_size);
+    for (int i = 0; i < variables; i++) {
+      for (int j = 0; j < R; j++) {
+        uint64_t limb = j == R - 1 ? 0 : ((uint64_t) rand() << 32) ^ (uint64_t) rand();
+        limbs[i * R + j] = limb;
+        for (int k = 0; k < 8; k++)
+          bytes[(i * R + (R - 1 - j)) * 8 + (7 - k)] = uint8_t(limb >> (8 * k));
+      }
+    }
+    const uint8_t* public_bytes = bytes.data();
+    const uint8_t* private_bytes = bytes.data() + PUBLIC_INPUTS * R * mp_limb_t_size;
+    const int private_inputs_length = variables - PUBLIC_INPUTS;
+
+    libsnark::r1cs_primary_input<FieldT> baseline_primary, bytes_primary, limbs_primary;
+    libsnark::r1cs_auxiliary_input<FieldT> baseline_auxiliary, bytes_auxiliary, limbs_auxiliary;
+
+    double baseline = seconds([&] {
+      pushBackWitness(public_bytes, PUBLIC_INPUTS, private_bytes, private_inputs_length, baseline_primary, baseline_auxiliary);
+    });
+    double from_bytes = seconds([&] {
+      witnessFromBytes<R>(public_bytes, PUBLIC_INPUTS, private_bytes, private_inputs_length, bytes_primary, bytes_auxiliary);
+    });
+    double from_limbs = seconds([&] {
+      witnessFromLimbs<R>(limbs.data(), PUBLIC_INPUTS, variables, limbs_primary, limbs_auxiliary);
+    });
+
+    if (bytes_primary != baseline_primary || bytes_auxiliary != baseline_auxiliary
+        || limbs_primary != baseline_primary || limbs_auxiliary != baseline_auxiliary) {
+      fprintf(stderr, "witness layouts disagree at %d variables\n", variables);
+      return 1;
+    }
+
+    printf("variables=%d push_back_seconds=%.3f bytes_seconds=%.3f limbs_seconds=%.3f\n",
+        variables, baseline, from_bytes, from_limbs);
+  }
+  return 0;
+}
@@ -19,25 +19,35 @@ fn main() {
             .join("deps")
             .join("libsnark");
 
+        // OpenMP-parallel multi-exponentiations and FFTs, opt-in through the `multicore` feature
+        let multicore = env::var("CARGO_FEATURE_MULTICORE").is_ok();
+
         // build libsnark
         let libsnark = cmake::Config::new(libsnark_source_path)
             .define("WITH_PROCPS", "OFF")
             .define("USE_PT_COMPRESSION", "OFF")
             .define("MONTGOMERY_OUTPUT", "ON")
             .define("BINARY_OUTPUT", "ON")
+            .define("MULTICORE", if multicore { "ON" } else { "OFF" })
             .build();
 
         // build backends
-        cc::Build::new()
+        let mut backends = cc::Build::new();
+        backends
             .cpp(true)
             .debug(cfg!(debug_assertions))
             .flag("-std=c++11")
             .include(libsnark_source_path)
             .include(libsnark_source_path.join("depends/libff"))
             .include(libsnark_source_path.join("depends/libfqfft"))
+            .file("lib/buffer.cpp")
             .file("lib/gm17.cpp")
-            .file("lib/pghr13.cpp")
-            .compile("libwraplibsnark.a");
+            .file("lib/pghr13.cpp");
+        if multicore {
+            // the wrapper instantiates libsnark templates, so it must agree with the library on MULTICORE
+            backends.define("MULTICORE", "1").flag("-fopenmp");
+        }
+        backends.compile("libwraplibsnark.a");
 
         println!(
             "cargo:rustc-link-search=native={}",
@@ -48,16 +58,52 @@ fn main() {
         println!("cargo:rustc-link-lib=gmpxx");
         println!("cargo:rustc-link-lib=ssl");
         println!("cargo:rustc-link-lib=crypto");
-
-        #[cfg(debug_assertions)]
-        {
-            println!("cargo:rustc-link-lib=static=snarkd");
-            println!("cargo:rustc-link-lib=static=ffd");
+        if multicore {
+            println!("cargo:rustc-link-lib=gomp");
         }
-        #[cfg(not(debug_assertions))]
-        {
-            println!("cargo:rustc-link-lib=static=snark");
-            println!("cargo:rustc-link-lib=static=ff");
+
+        let (snark_lib, ff_lib) = if cfg!(debug_assertions) {
+            ("snarkd", "ffd")
+        } else {
+            ("snark", "ff")
+        };
+        println!("cargo:rustc-link-lib=static={}", snark_lib);
+        println!("cargo:rustc-link-lib=static={}", ff_lib);
+
+        // micro-benchmarks of the backends, built next to the zokrates binary as
+        // `zokrates_bench_<name>` with the `bench` feature
+        if env::var("CARGO_FEATURE_BENCH").is_ok() {
+            let target_dir = PathBuf::from(env::var("OUT_DIR").unwrap())
+                .parent().unwrap()
+                .parent().unwrap()
+                .parent().unwrap()
+                .to_path_buf();
+            for entry in std::fs::read_dir("bench").unwrap() {
+                let source = entry.unwrap().path();
+                if source.extension().map_or(true, |e| e != "cpp") {
+                    continue;
+                }
+                println!("cargo:rerun-if-changed={}", source.display());
+                let name = source.file_stem().unwrap().to_str().unwrap();
+                // same flags, includes and defines as the backends
+                let mut command = backends.get_compiler().to_command();
+                command
+                    .arg("-O2")
+                    .arg(&source)
+                    .arg("-o")
+                    .arg(target_dir.join(format!("zokrates_bench_{}", name)))
+                    .arg(format!("-L{}", libsnark.join("lib").display()))
+                    .arg(format!("-L{}", env::var("OUT_DIR").unwrap()))
+                    .arg("-lwraplibsnark")
+                    .arg(format!("-l{}", snark_lib))
+                    .arg(format!("-l{}", ff_lib))
+                    .args(&["-lgmpxx", "-lgmp", "-lssl", "-lcrypto"]);
+                if multicore {
+                    command.arg("-lgomp");
+                }
+                let status = command.status().expect("failed to run the C++ compiler");
+                assert!(status.success(), "failed to build benchmark {}", name);
+            }
         }
     }
 }
@@ -30,7 +30,8 @@ class aggregator {
         std::vector<r1cs_ppzksnark_verification_key_variable<to>> verification_keys;
 
         std::vector<r1cs_ppzksnark_proof_variable<to>> proofs;
-        std::vector<pb_variable_array<to_field>> proofs_contents;
+        // the coordinates of each proof, packed straight from its bits
+        std::vector<pb_linear_combination_array<to_field>> proofs_contents;
         std::vector<multipacking_gadget<to_field> > unpack_proofs;
         std::vector<pb_variable_array<to_field>> proofs_bits;
 
@@ -38,7 +39,8 @@ class aggregator {
         std::shared_ptr<block_variable<to_field>> block_for_input_verification;
         std::shared_ptr<CRH_with_field_out_gadget<to_field>> hash_incoming_proof;
 
-        pb_variable<to_field> verification_result;
+        // one result per verifier, so that their witnesses can be generated concurrently
+        pb_variable_array<to_field> verification_results;
         std::vector<r1cs_ppzksnark_verifier_gadget<to>> verifiers;
 
         aggregator(size_t aggregation_arity, size_t inputs_count);
@@ -85,7 +87,9 @@ aggregator<from, to>::aggregator(size_t aggregation_arity, size_t inputs_count):
     }
 
     /**
-     * @brief Setup the wires for the proof and its bit decomposition
+     * @brief Setup the wires for the proof and its bit decomposition. The bits are packed
+     * into the G1 and G2 coordinates of the proof themselves, in that order, rather than
+     * into copies of them that would each need a constraint to match the proof.
      */
     proofs_bits.resize(aggregation_arity);
     proofs_contents.resize(aggregation_arity);
@@ -93,10 +97,15 @@ aggregator<from, to>::aggregator(size_t aggregation_arity, size_t inputs_count):
     {
         proofs.emplace_back(r1cs_ppzksnark_proof_variable<to>(pb, "proof"));
         proofs_bits[i].allocate(pb, proof_size_in_bits, "Proof in bits");
-        proofs_contents[i].allocate(pb,
-                r1cs_ppzksnark_proof_variable<to>::size(),
-                "Intermediate variable storing the field representation of the proof"
-                );
+        for(const auto &g1 : proofs[i].all_G1_vars)
+        {
+            proofs_contents[i].insert(proofs_contents[i].end(), g1->all_vars.begin(), g1->all_vars.end());
+        }
+        for(const auto &g2 : proofs[i].all_G2_vars)
+        {
+            proofs_contents[i].insert(proofs_contents[i].end(), g2->all_vars.begin(), g2->all_vars.end());
+        }
+        assert(proofs_contents[i].size() == r1cs_ppzksnark_proof_variable<to>::size());
         unpack_proofs.emplace_back(multipacking_gadget<to_field>(pb,
                     proofs_bits[i],
                     proofs_contents[i],
@@ -147,7 +156,7 @@ aggregator<from, to>::aggregator(size_t aggregation_arity, size_t inputs_count):
     /**
      * @brief Setup the wires for the verifier
      */
-    verification_result.allocate(pb, "Contains the result of the verification");
+    verification_results.allocate(pb, aggregation_arity, "Contains the result of each verification");
     for(uint i=0; i<aggregation_arity; i++)
     {
         verifiers.emplace_back(r1cs_ppzksnark_verifier_gadget<to>(pb,
@@ -155,7 +164,7 @@ aggregator<from, to>::aggregator(size_t aggregation_arity, size_t inputs_count):
                     verifier_inputs_bits[i],
                     elt_size,
                     proofs[i],
-                    verification_result,
+                    verification_results[i],
                     "Verifier gadget"
                     ));
     }
@@ -199,40 +208,6 @@ void aggregator<from, to>::generate_r1cs_constraints(){
         }
     }
 
-    // TODO: Cache this in an upperlayer proof variable.
-    // Since this is a lot of code for a tiny part of the aggregator
-    PROFILE_CONSTRAINTS(pb, "Map proof content"){
-        size_t counter;
-        for(uint k=0; k<aggregation_arity; k++){
-            counter=0;
-            for(size_t i=0; i<proofs[0].all_G1_vars.size(); i++)
-            {
-                for(size_t j=0; j<proofs[0].all_G1_vars[0]->all_vars.size(); j++)
-                {
-                    pb.add_r1cs_constraint(r1cs_constraint<to_field>(
-                                1,
-                                proofs[k].all_G1_vars[i]->all_vars[j],
-                                proofs_contents[k][counter]
-                                ));
-                    counter++;
-                }
-            }
-            for(size_t i=0; i<proofs[0].all_G2_vars.size(); i++)
-            {
-                for(size_t j=0; j<proofs[0].all_G2_vars[0]->all_vars.size(); j++)
-                {
-                    pb.add_r1cs_constraint(r1cs_constraint<to_field>(
-                                1,
-                                proofs[k].all_G2_vars[i]->all_vars[j],
-                                proofs_contents[k][counter]
-                                ));
-                    counter++;
-                }
-            }
-        }
-        assert(counter == proofs_contents[0].size());
-    }
-
     PROFILE_CONSTRAINTS(pb, "Check that proof is correct")
     {
         for(uint i=0; i<aggregation_arity; i++)
@@ -244,7 +219,10 @@ void aggregator<from, to>::generate_r1cs_constraints(){
 
     PROFILE_CONSTRAINTS(pb, "Miscellaneous")
     {
-        pb.add_r1cs_constraint(r1cs_constraint<to_field>(1, 1 - verification_result, 0), "Enforce valid proof");
+        for(uint i=0; i<aggregation_arity; i++)
+        {
+            pb.add_r1cs_constraint(r1cs_constraint<to_field>(1, 1 - verification_results[i], 0), "Enforce valid proof");
+        }
     }
 
     PRINT_CONSTRAINT_PROFILING();
@@ -258,6 +236,7 @@ void aggregator<from, to>::generate_r1cs_witness(
         std::vector<r1cs_ppzksnark_proof<from>> proof_value
         ){
 
+    // also hashes the proofs
     generate_primary_inputs(
             verification_key_value,
             verifier_input_values,
@@ -265,16 +244,15 @@ void aggregator<from, to>::generate_r1cs_witness(
             );
 
     /**
-     * @brief Generate witnesses for the CRH
+     * @brief Generate witnesses for the verifiers, which only share read-only wires
      */
-    hash_incoming_proof->generate_r1cs_witness();
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(dynamic)
+#endif
     for(size_t k=0; k<aggregation_arity; k++)
     {
         verifiers[k].generate_r1cs_witness();
     }
-
-    // TODO: check why circuit is not well valued
-    // assert(pb.is_satisfied());
 }
 
 
@@ -316,24 +294,10 @@ void aggregator<from, to>::generate_primary_inputs(
     }
 
     /**
-     * @brief Maps proof content with proof, and proof_bits with proof content
+     * @brief Unpacks the proof coordinates into proof_bits
      */
-    uint counter;
     for(size_t k=0; k<aggregation_arity; k++)
     {
-        counter = 0;
-        for(size_t i=0; i<proofs[0].all_G1_vars.size(); i++){
-            for(size_t j=0; j<proofs[0].all_G1_vars[0]->all_vars.size(); j++){
-                pb.val(proofs_contents[k][counter]) = pb.lc_val(proofs[k].all_G1_vars[i]->all_vars[j]);
-                counter++;
-            }
-        }
-        for(size_t i=0; i<proofs[0].all_G2_vars.size(); i++){
-            for(size_t j=0; j<proofs[0].all_G2_vars[0]->all_vars.size(); j++){
-                pb.val(proofs_contents[k][counter]) = pb.lc_val(proofs[k].all_G2_vars[i]->all_vars[j]);
-                counter++;
-            }
-        }
         unpack_proofs[k].generate_r1cs_witness_from_packed();
     }
 
@@ -341,11 +305,4 @@ void aggregator<from, to>::generate_primary_inputs(
      * @brief Generate witnesses for the CRH
      */
     hash_incoming_proof->generate_r1cs_witness();
-    // for(size_t k=0; k<aggregation_arity; k++)
-    // {
-    //     verifiers[k].generate_r1cs_witness();
-    // }
-
-    // TODO: check why circuit is not well valued
-    // assert(pb.is_satisfied());
 }
@@ -0,0 +1,703 @@
+#pragma once
+
+/**
+ * @file binary_format.tcc
+ * Fixed-layout binary serialization of proving keys.
+ *
+ * Points and field elements are stored exactly as they sit in memory
+ * (Montgomery form), so a key file can be mapped and copied straight into
+ * the key's vectors without going through libff's stream operators.
+ * The layout is only valid for the build that wrote it: the header records
+ * the curve and the in-memory sizes, and readers refuse anything else.
+ *
+ * With BINARY_FORMAT_COMPRESSED_POINTS set in the header, the key's points are
+ * stored as their affine x coordinate and a tag byte for the sign of y, which
+ * roughly halves the file; readers recover y with one square root per point,
+ * in parallel in multicore builds.
+ *
+ * With BINARY_FORMAT_SPARSE_QUERIES set, the dense query vectors of the key
+ * are stored as the indices of their non-zero points and those points only:
+ * variables missing from A and B leave points at infinity that are neither
+ * stored, read nor decompressed. libsnark's key types hold dense vectors, so
+ * readers put those points back in memory.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+#include "libff/algebra/curves/mnt/mnt4/mnt4_pp.hpp"
+#include "libff/algebra/curves/mnt/mnt6/mnt6_pp.hpp"
+#include <libsnark/common/data_structures/sparse_vector.hpp>
+#include <libsnark/knowledge_commitment/knowledge_commitment.hpp>
+#include <libsnark/relations/constraint_satisfaction_problems/r1cs/r1cs.hpp>
+
+#include "util.tcc"
+
+const char BINARY_FORMAT_MAGIC[4] = { 'Z', 'K', 'P', 'K' };
+const uint32_t BINARY_FORMAT_VERSION = 1;
+
+// header flags
+const uint32_t BINARY_FORMAT_COMPRESSED_POINTS = 1;
+const uint32_t BINARY_FORMAT_SPARSE_QUERIES = 2;
+
+enum binary_format_scheme : uint32_t {
+  BINARY_FORMAT_GM17 = 1,
+  BINARY_FORMAT_PGHR13 = 2,
+  BINARY_FORMAT_GM17_PREPARED = 3,
+  BINARY_FORMAT_PGHR13_PREPARED = 4,
+};
+
+template<typename ppT> struct binary_format_curve;
+template<> struct binary_format_curve<libff::alt_bn128_pp> { static const uint32_t id = 1; };
+template<> struct binary_format_curve<libff::mnt4_pp> { static const uint32_t id = 2; };
+template<> struct binary_format_curve<libff::mnt6_pp> { static const uint32_t id = 3; };
+
+struct binary_format_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t scheme;
+  uint32_t curve;
+  uint32_t flags;
+  uint32_t fr_size;
+  uint32_t g1_size;
+  uint32_t g2_size;
+};
+
+template<typename ppT>
+binary_format_header binaryFormatHeader(binary_format_scheme scheme, uint32_t flags = 0)
+{
+  binary_format_header header;
+  memcpy(header.magic, BINARY_FORMAT_MAGIC, sizeof(header.magic));
+  header.version = BINARY_FORMAT_VERSION;
+  header.scheme = scheme;
+  header.curve = binary_format_curve<ppT>::id;
+  header.flags = flags;
+  header.fr_size = sizeof(libff::Fr<ppT>);
+  header.g1_size = sizeof(libff::G1<ppT>);
+  header.g2_size = sizeof(libff::G2<ppT>);
+  return header;
+}
+
+// read-only private mapping of a whole file, unmapped on destruction
+class mapped_file {
+  public:
+    mapped_file(const std::string& path) : data_(nullptr), size_(0)
+    {
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+        return;
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+          madvise(p, st.st_size, MADV_SEQUENTIAL);
+          data_ = (const uint8_t*) p;
+          size_ = st.st_size;
+        }
+      }
+      close(fd);
+    }
+
+    ~mapped_file()
+    {
+      if (data_ != nullptr)
+        munmap((void*) data_, size_);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool is_open() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+  private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+// size, inode and modification time of a file; setup renames new keys into place, so each of
+// its runs gives the key file another identity
+struct file_identity {
+  uint64_t size = 0;
+  uint64_t inode = 0;
+  int64_t mtime_sec = 0;
+  int64_t mtime_nsec = 0;
+
+  bool operator==(const file_identity& other) const
+  {
+    return size == other.size && inode == other.inode && mtime_sec == other.mtime_sec && mtime_nsec == other.mtime_nsec;
+  }
+
+  bool operator!=(const file_identity& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+inline bool fileIdentity(const char* path, file_identity& identity)
+{
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return false;
+  identity.size = st.st_size;
+  identity.inode = st.st_ino;
+#ifdef __APPLE__
+  identity.mtime_sec = st.st_mtimespec.tv_sec;
+  identity.mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+  identity.mtime_sec = st.st_mtim.tv_sec;
+  identity.mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+// SHA-256 of a whole file
+inline bool fileDigest(const char* path, std::string& digest)
+{
+  mapped_file file(path);
+  if (!file.is_open())
+    return false;
+  sha256_digest sha;
+  sha.update(file.data(), file.size());
+  digest = sha.hex();
+  return true;
+}
+
+// writes to a file, or appends to `memory` when constructed with it
+class binary_writer {
+  public:
+    binary_writer(const std::string& path) : buffer(1 << 20), memory(nullptr)
+    {
+      fh.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+      fh.open(path, std::ios::binary | std::ios::trunc);
+    }
+
+    explicit binary_writer(std::string* memory) : memory(memory) {}
+
+    template<typename T>
+    void write(const T& value)
+    {
+      write_bytes(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void write_vector(const std::vector<T>& v)
+    {
+      write<uint64_t>(v.size());
+      write_bytes(v.data(), v.size() * sizeof(T));
+    }
+
+    template<typename T>
+    void write_array(const T* data, size_t count)
+    {
+      write_bytes(data, count * sizeof(T));
+    }
+
+    bool close()
+    {
+      if (memory != nullptr)
+        return true;
+      fh.flush();
+      bool ok = fh.good();
+      fh.close();
+      return ok;
+    }
+
+  private:
+    void write_bytes(const void* data, size_t size)
+    {
+      if (memory != nullptr)
+        memory->append((const char*) data, size);
+      else
+        fh.write((const char*) data, size);
+    }
+
+    std::vector<char> buffer;
+    std::string* memory;
+    std::ofstream fh;
+};
+
+// bounds-checked cursor over a byte range; every read fails once the range is exhausted
+class binary_reader {
+  public:
+    binary_reader(const uint8_t* data, size_t size) : cursor(data), end(data + size), ok(true) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+      if (!ok || (size_t)(end - cursor) < sizeof(T))
+        return ok = false;
+      memcpy(&value, cursor, sizeof(T));
+      cursor += sizeof(T);
+      return true;
+    }
+
+    template<typename T>
+    bool read_vector(std::vector<T>& v)
+    {
+      uint64_t size;
+      if (!read(size) || size > (uint64_t)(end - cursor) / sizeof(T))
+        return ok = false;
+      v.resize(size);
+      memcpy((void*) v.data(), cursor, size * sizeof(T));
+      cursor += size * sizeof(T);
+      return true;
+    }
+
+    // points `data` at `count` elements in place instead of copying them out
+    template<typename T>
+    bool view_array(const T*& data, uint64_t count)
+    {
+      if (!ok || count > (uint64_t)(end - cursor) / sizeof(T) || (uintptr_t) cursor % alignof(T) != 0)
+        return ok = false;
+      data = (const T*) cursor;
+      cursor += count * sizeof(T);
+      return true;
+    }
+
+    bool good() const { return ok; }
+    bool at_end() const { return cursor == end; }
+
+  private:
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool ok;
+};
+
+inline bool hasBinaryFormatMagic(const uint8_t* data, size_t size)
+{
+  return size >= sizeof(binary_format_header) && memcmp(data, BINARY_FORMAT_MAGIC, sizeof(BINARY_FORMAT_MAGIC)) == 0;
+}
+
+template<typename ppT>
+bool checkBinaryFormatHeader(const uint8_t* data, size_t size, binary_format_scheme scheme)
+{
+  binary_format_header expected = binaryFormatHeader<ppT>(scheme);
+  binary_format_header header;
+  binary_reader reader(data, size);
+  if (!reader.read(header) || header.version != expected.version || header.scheme != expected.scheme || header.curve != expected.curve
+      || header.fr_size != expected.fr_size || header.g1_size != expected.g1_size || header.g2_size != expected.g2_size
+      || (header.flags & ~(BINARY_FORMAT_COMPRESSED_POINTS | BINARY_FORMAT_SPARSE_QUERIES)) != 0) {
+    std::cerr << "binary proving key was written for another scheme, curve or build" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template<typename FieldT>
+void writeConstraintSystem(binary_writer& writer, const libsnark::r1cs_constraint_system<FieldT>& cs)
+{
+  writer.write<uint64_t>(cs.primary_input_size);
+  writer.write<uint64_t>(cs.auxiliary_input_size);
+  writer.write<uint64_t>(cs.constraints.size());
+  for (const libsnark::r1cs_constraint<FieldT>& constraint : cs.constraints) {
+    writer.write_vector(constraint.a.terms);
+    writer.write_vector(constraint.b.terms);
+    writer.write_vector(constraint.c.terms);
+  }
+}
+
+template<typename FieldT>
+bool readConstraintSystem(binary_reader& reader, libsnark::r1cs_constraint_system<FieldT>& cs)
+{
+  uint64_t primary_input_size, auxiliary_input_size, num_constraints;
+  if (!reader.read(primary_input_size) || !reader.read(auxiliary_input_size) || !reader.read(num_constraints))
+    return false;
+  cs.primary_input_size = primary_input_size;
+  cs.auxiliary_input_size = auxiliary_input_size;
+  cs.constraints.clear();
+  cs.constraints.resize(num_constraints);
+  for (libsnark::r1cs_constraint<FieldT>& constraint : cs.constraints) {
+    if (!reader.read_vector(constraint.a.terms) || !reader.read_vector(constraint.b.terms) || !reader.read_vector(constraint.c.terms))
+      return false;
+  }
+  return true;
+}
+
+// SHA-256 of the constraint system in the layout written by writeConstraintSystem
+template<typename FieldT>
+std::string constraintSystemDigest(const libsnark::r1cs_constraint_system<FieldT>& cs)
+{
+  sha256_digest sha;
+  uint64_t sizes[3] = { cs.primary_input_size, cs.auxiliary_input_size, cs.constraints.size() };
+  sha.update(sizes, sizeof(sizes));
+  for (const libsnark::r1cs_constraint<FieldT>& constraint : cs.constraints) {
+    for (const libsnark::linear_combination<FieldT>* lc : { &constraint.a, &constraint.b, &constraint.c }) {
+      uint64_t count = lc->terms.size();
+      sha.update(&count, sizeof(count));
+      sha.update(lc->terms.data(), lc->terms.size() * sizeof(libsnark::linear_term<FieldT>));
+    }
+  }
+  return sha.hex();
+}
+
+// whether the environment variable `name` is set to anything but "" or "0"
+inline bool envFlag(const char* name)
+{
+  const char* value = getenv(name);
+  return value != nullptr && *value != '\0' && strcmp(value, "0") != 0;
+}
+
+// setup writes sparse query vectors unless ZOKRATES_DENSE_KEYS is set, and compressed proving
+// keys when ZOKRATES_COMPRESS_KEYS is
+inline uint32_t binaryFormatFlagsFromEnv()
+{
+  return (envFlag("ZOKRATES_DENSE_KEYS") ? 0 : BINARY_FORMAT_SPARSE_QUERIES)
+    | (envFlag("ZOKRATES_COMPRESS_KEYS") ? BINARY_FORMAT_COMPRESSED_POINTS : 0);
+}
+
+// y^2 = x^3 + a*x + b for each group, to recover y from x
+template<typename GT> struct curve_equation;
+
+template<> struct curve_equation<libff::alt_bn128_G1> {
+  typedef libff::alt_bn128_Fq field;
+  static field a() { return field::zero(); }
+  static field b() { return libff::alt_bn128_coeff_b; }
+};
+
+template<> struct curve_equation<libff::alt_bn128_G2> {
+  typedef libff::alt_bn128_Fq2 field;
+  static field a() { return field::zero(); }
+  static field b() { return libff::alt_bn128_twist_coeff_b; }
+};
+
+template<> struct curve_equation<libff::mnt4_G1> {
+  typedef libff::mnt4_Fq field;
+  static field a() { return libff::mnt4_G1::coeff_a; }
+  static field b() { return libff::mnt4_G1::coeff_b; }
+};
+
+template<> struct curve_equation<libff::mnt4_G2> {
+  typedef libff::mnt4_Fq2 field;
+  static field a() { return libff::mnt4_G2::coeff_a; }
+  static field b() { return libff::mnt4_G2::coeff_b; }
+};
+
+template<> struct curve_equation<libff::mnt6_G1> {
+  typedef libff::mnt6_Fq field;
+  static field a() { return libff::mnt6_G1::coeff_a; }
+  static field b() { return libff::mnt6_G1::coeff_b; }
+};
+
+template<> struct curve_equation<libff::mnt6_G2> {
+  typedef libff::mnt6_Fq3 field;
+  static field a() { return libff::mnt6_G2::coeff_a; }
+  static field b() { return libff::mnt6_G2::coeff_b; }
+};
+
+// sign of a y coordinate: parity of its first non-zero component, as an integer
+template<mp_size_t n, const libff::bigint<n>& modulus>
+bool isOdd(const libff::Fp_model<n, modulus>& y)
+{
+  return y.as_bigint().data[0] & 1;
+}
+
+template<mp_size_t n, const libff::bigint<n>& modulus>
+bool isOdd(const libff::Fp2_model<n, modulus>& y)
+{
+  return y.c0.is_zero() ? isOdd(y.c1) : isOdd(y.c0);
+}
+
+template<mp_size_t n, const libff::bigint<n>& modulus>
+bool isOdd(const libff::Fp3_model<n, modulus>& y)
+{
+  return !y.c0.is_zero() ? isOdd(y.c0) : !y.c1.is_zero() ? isOdd(y.c1) : isOdd(y.c2);
+}
+
+// Euler's criterion; libff's sqrt does not terminate on non-squares, nor on zero
+template<typename FieldT>
+bool hasNonZeroSqrt(const FieldT& y2)
+{
+  return !y2.is_zero() && (y2 ^ FieldT::euler) == FieldT::one();
+}
+
+enum compressed_point_tag : uint8_t {
+  POINT_EVEN_Y = 0,
+  POINT_ODD_Y = 1,
+  POINT_AT_INFINITY = 2,
+};
+
+// affine x coordinates, then one tag per point, in the layout of write_vector. The
+// coordinates are computed and written a block at a time, so that only the tags are
+// held for the whole of `points`.
+template<typename GT, typename PointF>
+void writeCompressedPoints(binary_writer& writer, size_t count, PointF point)
+{
+  typedef typename curve_equation<GT>::field field;
+  const size_t block = 1 << 16;
+  std::vector<field> xs(std::min(count, block));
+  std::vector<uint8_t> tags(count);
+
+  writer.write<uint64_t>(count);
+  for (size_t start = 0; start < count; start += block) {
+    const size_t end = std::min(count, start + block);
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(static)
+#endif
+    for (size_t i = start; i < end; i++) {
+      GT p = point(i);
+      if (p.is_zero()) {
+        xs[i - start] = field::zero();
+        tags[i] = POINT_AT_INFINITY;
+      } else {
+        p.to_affine_coordinates();
+        xs[i - start] = pointX(p);
+        tags[i] = isOdd(pointY(p)) ? POINT_ODD_Y : POINT_EVEN_Y;
+      }
+    }
+    writer.write_array(xs.data(), end - start);
+  }
+
+  writer.write_vector(tags);
+}
+
+template<typename GT>
+void writeCompressedPoints(binary_writer& writer, const std::vector<GT>& points)
+{
+  writeCompressedPoints<GT>(writer, points.size(), [&](size_t i) { return points[i]; });
+}
+
+// fails on unknown tags and on x coordinates that are not on the curve, before any
+// square root is taken
+template<typename GT>
+bool readCompressedPoints(binary_reader& reader, std::vector<GT>& points)
+{
+  typedef typename curve_equation<GT>::field field;
+  std::vector<field> xs;
+  std::vector<uint8_t> tags;
+  if (!reader.read_vector(xs) || !reader.read_vector(tags) || xs.size() != tags.size())
+    return false;
+
+  const field a = curve_equation<GT>::a();
+  const field b = curve_equation<GT>::b();
+  points.resize(xs.size());
+  bool ok = true;
+
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(static) reduction(&&:ok)
+#endif
+  for (size_t i = 0; i < xs.size(); i++) {
+    if (tags[i] == POINT_AT_INFINITY) {
+      points[i] = GT::zero();
+      continue;
+    }
+    if (tags[i] > POINT_ODD_Y) {
+      ok = false;
+      continue;
+    }
+    const field& x = xs[i];
+    const field y2 = (x.squared() + a) * x + b;
+    if (!hasNonZeroSqrt(y2)) {
+      ok = false;
+      continue;
+    }
+    field y = y2.sqrt();
+    if (isOdd(y) != (tags[i] == POINT_ODD_Y))
+      y = -y;
+    points[i] = GT(x, y, field::one());
+  }
+  return ok;
+}
+
+template<typename GT>
+void writePoints(binary_writer& writer, const std::vector<GT>& points, bool compressed)
+{
+  if (compressed)
+    writeCompressedPoints(writer, points);
+  else
+    writer.write_vector(points);
+}
+
+template<typename GT>
+bool readPoints(binary_reader& reader, std::vector<GT>& points, bool compressed)
+{
+  return compressed ? readCompressedPoints(reader, points) : reader.read_vector(points);
+}
+
+// both halves of the commitments are compressed, one after the other
+template<typename T1, typename T2>
+void writePoints(binary_writer& writer, const std::vector<libsnark::knowledge_commitment<T1, T2>>& points, bool compressed)
+{
+  if (!compressed) {
+    writer.write_vector(points);
+    return;
+  }
+  writeCompressedPoints<T1>(writer, points.size(), [&](size_t i) { return points[i].g; });
+  writeCompressedPoints<T2>(writer, points.size(), [&](size_t i) { return points[i].h; });
+}
+
+template<typename T1, typename T2>
+bool readPoints(binary_reader& reader, std::vector<libsnark::knowledge_commitment<T1, T2>>& points, bool compressed)
+{
+  if (!compressed)
+    return reader.read_vector(points);
+  std::vector<T1> g;
+  std::vector<T2> h;
+  if (!readCompressedPoints(reader, g) || !readCompressedPoints(reader, h) || g.size() != h.size())
+    return false;
+  points.resize(g.size());
+  for (size_t i = 0; i < g.size(); i++)
+    points[i] = libsnark::knowledge_commitment<T1, T2>(g[i], h[i]);
+  return true;
+}
+
+// the size of `points`, the indices of its non-zero points, then those points as writePoints
+// writes them
+template<typename GT>
+void writeSparsePoints(binary_writer& writer, const std::vector<GT>& points, bool compressed)
+{
+  std::vector<uint64_t> indices;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (!points[i].is_zero())
+      indices.push_back(i);
+  }
+  writer.write<uint64_t>(points.size());
+  writer.write_vector(indices);
+  if (compressed) {
+    writeCompressedPoints<GT>(writer, indices.size(), [&](size_t i) { return points[indices[i]]; });
+    return;
+  }
+  writer.write<uint64_t>(indices.size());
+  for (uint64_t i : indices)
+    writer.write(points[i]);
+}
+
+// fails on indices that are out of range or not increasing
+template<typename GT>
+bool readSparsePoints(binary_reader& reader, std::vector<GT>& points, bool compressed)
+{
+  uint64_t size;
+  std::vector<uint64_t> indices;
+  std::vector<GT> values;
+  if (!reader.read(size) || !reader.read_vector(indices) || !readPoints(reader, values, compressed)
+      || values.size() != indices.size() || indices.size() > size)
+    return false;
+  points.assign(size, GT::zero());
+  for (size_t i = 0; i < indices.size(); i++) {
+    if (indices[i] >= size || (i > 0 && indices[i] <= indices[i - 1]))
+      return false;
+    points[indices[i]] = values[i];
+  }
+  return true;
+}
+
+// the dense query vectors of a proving key, sparse when the header says so
+template<typename GT>
+void writeQuery(binary_writer& writer, const std::vector<GT>& points, uint32_t flags)
+{
+  if (flags & BINARY_FORMAT_SPARSE_QUERIES)
+    writeSparsePoints(writer, points, flags & BINARY_FORMAT_COMPRESSED_POINTS);
+  else
+    writePoints(writer, points, flags & BINARY_FORMAT_COMPRESSED_POINTS);
+}
+
+template<typename GT>
+bool readQuery(binary_reader& reader, std::vector<GT>& points, uint32_t flags)
+{
+  if (flags & BINARY_FORMAT_SPARSE_QUERIES)
+    return readSparsePoints(reader, points, flags & BINARY_FORMAT_COMPRESSED_POINTS);
+  return readPoints(reader, points, flags & BINARY_FORMAT_COMPRESSED_POINTS);
+}
+
+// the points the queries of a proving key hold and those left once the points at infinity
+// are pruned, printed by setup for each circuit
+class query_pruning_stats {
+  public:
+    template<typename GT>
+    void add(const char* query, const std::vector<GT>& points)
+    {
+      size_t stored = 0;
+      for (const GT& p : points)
+        stored += !p.is_zero();
+      add(query, points.size(), stored);
+    }
+
+    // libsnark's generator already leaves the zero commitments out of sparse vectors
+    template<typename T>
+    void add(const char* query, const libsnark::sparse_vector<T>& v)
+    {
+      add(query, v.domain_size_, v.indices.size());
+    }
+
+    void print() const
+    {
+      for (const entry& e : entries)
+        std::cout << "proving key " << e.query << ": " << e.stored << " of " << e.points << " points stored" << std::endl;
+      const size_t pruned = total_points - total_stored;
+      std::stringstream share;
+      share << std::fixed << std::setprecision(1) << (total_points == 0 ? 0.0 : 100.0 * pruned / total_points);
+      std::cout << "proving key: " << total_stored << " of " << total_points << " points stored, " << pruned
+                << " at infinity pruned (" << share.str() << "%)" << std::endl;
+    }
+
+  private:
+    struct entry {
+      const char* query;
+      size_t points;
+      size_t stored;
+    };
+
+    void add(const char* query, size_t count, size_t stored_count)
+    {
+      entry e = { query, count, stored_count };
+      entries.push_back(e);
+      total_points += count;
+      total_stored += stored_count;
+    }
+
+    std::vector<entry> entries;
+    size_t total_points = 0;
+    size_t total_stored = 0;
+};
+
+template<typename GT>
+void writePoint(binary_writer& writer, const GT& point, bool compressed)
+{
+  if (compressed)
+    writeCompressedPoints(writer, std::vector<GT>(1, point));
+  else
+    writer.write(point);
+}
+
+template<typename GT>
+bool readPoint(binary_reader& reader, GT& point, bool compressed)
+{
+  if (!compressed)
+    return reader.read(point);
+  std::vector<GT> points;
+  if (!readCompressedPoints(reader, points) || points.size() != 1)
+    return false;
+  point = points[0];
+  return true;
+}
+
+template<typename T>
+void writeSparseVector(binary_writer& writer, const libsnark::sparse_vector<T>& v, bool compressed)
+{
+  writer.write<uint64_t>(v.domain_size_);
+  writer.write_vector(v.indices);
+  writePoints(writer, v.values, compressed);
+}
+
+template<typename T>
+bool readSparseVector(binary_reader& reader, libsnark::sparse_vector<T>& v, bool compressed)
+{
+  uint64_t domain_size;
+  if (!reader.read(domain_size) || !reader.read_vector(v.indices) || !readPoints(reader, v.values, compressed))
+    return false;
+  v.domain_size_ = domain_size;
+  return v.indices.size() == v.values.size();
+}
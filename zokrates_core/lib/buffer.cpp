@@ -0,0 +1,14 @@
+/**
+ * @file buffer.cpp
+ * Release of the buffers handed out by the `*_buffers` entry points.
+ */
+
+#include "buffer.hpp"
+#include <cstdlib>
+
+void _free_buffer(struct buffer* buffer)
+{
+  free(buffer->data);
+  buffer->data = nullptr;
+  buffer->length = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+/**
+ * @file buffer.hpp
+ * In-memory hand-over of keys and proofs, for the `*_buffers` entry points.
+ * Each buffer holds what the file-based entry points write to the file of
+ * the same name.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// bytes owned by the caller, only read by the library
+struct byte_range {
+  const uint8_t* data;
+  uint64_t length;
+};
+
+// bytes allocated by the library and owned by the caller, who releases them with _free_buffer
+struct buffer {
+  uint8_t* data;
+  uint64_t length;
+};
+
+void _free_buffer(struct buffer* buffer);
+
+// verification key: `text` as in <vk>, `raw` as in <vk>.raw
+struct vk_buffers {
+  struct buffer text;
+  struct buffer raw;
+};
+
+// proof: `json` as in <proof>, `raw` as in <proof>.raw, `input` as in <proof>.input.raw
+struct proof_buffers {
+  struct buffer json;
+  struct buffer raw;
+  struct buffer input;
+};
+
+// what verification and batching read from a proof
+struct proof_range {
+  struct byte_range raw;
+  struct byte_range input;
+};
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
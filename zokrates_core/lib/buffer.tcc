@@ -0,0 +1,213 @@
+#pragma once
+
+/**
+ * @file buffer.tcc
+ * Keys and proofs serialized in memory. The file-based entry points write
+ * these bytes to their files, the `*_buffers` ones hand them to the caller.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "buffer.hpp"
+#include "util.tcc"
+
+// a verification key as setup exports it
+struct vk_bytes {
+  std::string text;
+  std::string raw;
+};
+
+// a proof as the provers export it
+struct proof_bytes {
+  std::string json;
+  std::string raw;
+  std::string input;
+};
+
+// read-only stream over bytes owned by someone else
+class range_streambuf : public std::streambuf {
+  public:
+    range_streambuf(const uint8_t* data, size_t size)
+    {
+      char* begin = (char*) data;
+      setg(begin, begin, begin + size);
+    }
+};
+
+// the libff stream serialization, as writeToFile writes it
+template<typename T>
+std::string serializeToString(const T& obj)
+{
+  std::stringstream ss;
+  ss << obj;
+  return ss.str();
+}
+
+template<typename T>
+T deserializeFromRange(const byte_range& range)
+{
+  range_streambuf buf(range.data, range.length);
+  std::istream in(&buf);
+  T obj;
+  in >> obj;
+  return obj;
+}
+
+// the same, reporting whether the stream parsed
+template<typename T>
+bool deserializeFromRange(const byte_range& range, T& obj)
+{
+  range_streambuf buf(range.data, range.length);
+  std::istream in(&buf);
+  in >> obj;
+  return !in.fail();
+}
+
+// the size and elements of `v`, as writeVectorToFile writes them
+template<typename T>
+std::string serializeVectorToString(const std::vector<T>& v)
+{
+  std::stringstream ss;
+  ss << v.size() << "\n";
+  for (const T& t : v)
+    ss << t << OUTPUT_NEWLINE;
+  return ss.str();
+}
+
+template<typename T>
+std::vector<T> deserializeVectorFromRange(const byte_range& range)
+{
+  range_streambuf buf(range.data, range.length);
+  std::istream in(&buf);
+  size_t size = 0;
+  in >> size;
+  char c;
+  in.read(&c, 1);
+  std::vector<T> v(size);
+  for (size_t i = 0; i < size; ++i) {
+    in >> v[i];
+    in.read(&c, 1);
+  }
+  return v;
+}
+
+inline byte_range rangeOf(const std::string& bytes)
+{
+  byte_range range = { (const uint8_t*) bytes.data(), bytes.size() };
+  return range;
+}
+
+inline bool writeStringToFile(const std::string& path, const std::string& bytes)
+{
+  std::ofstream fh(path, std::ios::binary | std::ios::trunc);
+  fh.write(bytes.data(), bytes.size());
+  fh.flush();
+  return fh.good();
+}
+
+inline bool readFileToString(const std::string& path, std::string& bytes)
+{
+  std::ifstream fh(path, std::ios::binary | std::ios::ate);
+  if (!fh.is_open())
+    return false;
+  bytes.resize(fh.tellg());
+  fh.seekg(0);
+  fh.read(&bytes[0], bytes.size());
+  return fh.good();
+}
+
+// setup and batch export their verification key either to <vk> and <vk>.raw, the raw key
+// serialized straight into its file, or to memory for the `*_buffers` entry points
+template<typename VkT>
+bool storeVerificationKey(const std::string& text, const VkT& vk, const char* vk_path)
+{
+  return writeStringToFile(vk_path, text) && writeToFile(std::string(vk_path).append(".raw"), vk);
+}
+
+template<typename VkT>
+bool storeVerificationKey(const std::string& text, const VkT& vk, vk_bytes& out)
+{
+  out.text = text;
+  out.raw = serializeToString(vk);
+  return true;
+}
+
+// <proof>, <proof>.raw and <proof>.input.raw
+inline bool writeProofFiles(const proof_bytes& proof, const char* proof_path)
+{
+  return writeStringToFile(proof_path, proof.json)
+    && writeStringToFile(std::string(proof_path).append(".raw"), proof.raw)
+    && writeStringToFile(std::string(proof_path).append(".input.raw"), proof.input);
+}
+
+inline bool readVerificationKeyFile(const char* vk_path, std::string& raw)
+{
+  std::string raw_vk_path = std::string(vk_path).append(".raw");
+  if (!readFileToString(raw_vk_path, raw)) {
+    std::cerr << "missing raw verification key " << raw_vk_path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+inline bool readProofFiles(const char* proof_path, std::string& raw, std::string& input)
+{
+  if (!readFileToString(std::string(proof_path).append(".raw"), raw) || !readFileToString(std::string(proof_path).append(".input.raw"), input)) {
+    std::cerr << "missing raw proof or input for " << proof_path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// reads the raw proofs next to the given paths; the ranges of missing ones are left empty
+inline std::vector<proof_range> readProofs(const char* const* proof_paths, int count, std::vector<std::string>& storage)
+{
+  storage.resize(2 * count);
+  std::vector<proof_range> proofs(count);
+  for (int i = 0; i < count; i++) {
+    if (readProofFiles(proof_paths[i], storage[2 * i], storage[2 * i + 1])) {
+      proofs[i].raw = rangeOf(storage[2 * i]);
+      proofs[i].input = rangeOf(storage[2 * i + 1]);
+    }
+  }
+  return proofs;
+}
+
+inline bool toBuffer(const std::string& bytes, buffer* out)
+{
+  out->data = (uint8_t*) malloc(bytes.empty() ? 1 : bytes.size());
+  out->length = out->data == nullptr ? 0 : bytes.size();
+  if (out->data == nullptr)
+    return false;
+  memcpy(out->data, bytes.data(), bytes.size());
+  return true;
+}
+
+// on failure, nothing is left allocated
+inline bool toBuffers(const vk_bytes& vk, vk_buffers* out)
+{
+  *out = vk_buffers();
+  if (toBuffer(vk.text, &out->text) && toBuffer(vk.raw, &out->raw))
+    return true;
+  _free_buffer(&out->text);
+  _free_buffer(&out->raw);
+  return false;
+}
+
+inline bool toBuffers(const proof_bytes& proof, proof_buffers* out)
+{
+  *out = proof_buffers();
+  if (toBuffer(proof.json, &out->json) && toBuffer(proof.raw, &out->raw) && toBuffer(proof.input, &out->input))
+    return true;
+  _free_buffer(&out->json);
+  _free_buffer(&out->raw);
+  _free_buffer(&out->input);
+  return false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+/**
+ * @file constraint_stream.hpp
+ * Chunked hand-over of constraint rows from the caller to the setup.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// consecutive constraint rows, each of A, B and C being an array of
+// {int constraint_id, int variable_id, uint8_t value[]} sorted by constraint id
+struct constraint_chunk {
+  const uint8_t* A;
+  const uint8_t* B;
+  const uint8_t* C;
+  int A_len;
+  int B_len;
+  int C_len;
+  int rows;
+};
+
+// fills `chunk` with the rows following the previous chunk and returns true, or returns false
+// once every row was handed over. The buffers only need to stay valid until the next call.
+typedef bool (*constraint_chunk_callback)(void* state, struct constraint_chunk* chunk);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <cassert>
 #include <iomanip>
+#include <algorithm>
 
 // contains definition of alt_bn128 ec public parameters
 #include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
@@ -17,6 +18,14 @@
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_se_ppzksnark/r1cs_se_ppzksnark.hpp>
 
 #include "util.tcc"
+#include "binary_format.tcc"
+#include "buffer.tcc"
+#include "key_cache.tcc"
+#include "r1cs_builder.tcc"
+#include "witness.tcc"
+#include "profiling.tcc"
+#include "prover.tcc"
+#include "setup_cache.tcc"
 
 typedef long integer_coeff_t;
 
@@ -27,167 +36,686 @@ namespace gm17 {
 
 //takes input and puts it into constraint system
 template<mp_size_t R, typename ppT>
-r1cs_se_ppzksnark_constraint_system<ppT> createConstraintSystem(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs)
+bool createConstraintSystem(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, r1cs_se_ppzksnark_constraint_system<ppT>& cs)
 {
-  r1cs_se_ppzksnark_constraint_system<ppT> cs;
-  cs.primary_input_size = inputs;
-  cs.auxiliary_input_size = variables - inputs - 1; // ~one not included
-
-  cout << "num variables: " << variables <<endl;
-  cout << "num constraints: " << constraints <<endl;
-  cout << "num inputs: " << inputs <<endl;
-
-  struct VariableValueMapping {
-    int constraint_id;
-    int variable_id;
-    uint8_t variable_value[R*mp_limb_t_size];
-  };
-  const VariableValueMapping* A_vvmap = (VariableValueMapping*) A;
-  const VariableValueMapping* B_vvmap = (VariableValueMapping*) B;
-  const VariableValueMapping* C_vvmap = (VariableValueMapping*) C;
-
-  int A_id = 0;
-  int B_id = 0;
-  int C_id = 0;
-
-  for (int row = 0; row < constraints; row++) {
-    linear_combination<libff::Fr<ppT> > lin_comb_A, lin_comb_B, lin_comb_C;
-
-    while (A_id < A_len && A_vvmap[A_id].constraint_id == row) {
-      libff::bigint<R> value = libsnarkBigintFromBytes<R>(A_vvmap[A_id].variable_value);
-      if (!value.is_zero())
-        lin_comb_A.add_term(A_vvmap[A_id].variable_id, value);
-      A_id++;
-    }
-    while (B_id < B_len && B_vvmap[B_id].constraint_id == row) {
-      libff::bigint<R> value = libsnarkBigintFromBytes<R>(B_vvmap[B_id].variable_value);
-      if (!value.is_zero())
-        lin_comb_B.add_term(B_vvmap[B_id].variable_id, value);
-      B_id++;
-    }
-    while (C_id < C_len && C_vvmap[C_id].constraint_id == row) {
-      libff::bigint<R> value = libsnarkBigintFromBytes<R>(C_vvmap[C_id].variable_value);
-      if (!value.is_zero())
-        lin_comb_C.add_term(C_vvmap[C_id].variable_id, value);
-      C_id++;
-    }
+  profile_phase building("constraint_building");
+  if (!buildConstraintSystem<R, libff::Fr<ppT>>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, cs))
+    return false;
+  building.end();
+  assert(cs.num_variables() >= (unsigned)inputs);
+  assert(cs.num_inputs() == (unsigned)inputs);
+  return true;
+}
+
+template<typename ppT>
+void serializeProvingKey(binary_writer& writer, const r1cs_se_ppzksnark_proving_key<ppT>& pk){
+  const uint32_t flags = binaryFormatFlagsFromEnv();
+  const bool compressed = flags & BINARY_FORMAT_COMPRESSED_POINTS;
+  writer.write(binaryFormatHeader<ppT>(BINARY_FORMAT_GM17, flags));
+  writeQuery(writer, pk.A_query, flags);
+  writeQuery(writer, pk.B_query, flags);
+  writeQuery(writer, pk.C_query_1, flags);
+  writeQuery(writer, pk.C_query_2, flags);
+  writePoint(writer, pk.G_gamma_Z, compressed);
+  writePoint(writer, pk.H_gamma_Z, compressed);
+  writePoint(writer, pk.G_ab_gamma_Z, compressed);
+  writePoint(writer, pk.G_gamma2_Z2, compressed);
+  writePoints(writer, pk.G_gamma2_Z_t, compressed);
+  writeConstraintSystem(writer, pk.constraint_system);
+}
 
-    cs.add_constraint(r1cs_constraint<libff::Fr<ppT> >(lin_comb_A, lin_comb_B, lin_comb_C));
+// G_gamma2_Z_t holds powers of t, none of them zero
+template<typename ppT>
+void printPruningStats(const r1cs_se_ppzksnark_proving_key<ppT>& pk)
+{
+  query_pruning_stats stats;
+  stats.add("A_query", pk.A_query);
+  stats.add("B_query", pk.B_query);
+  stats.add("C_query_1", pk.C_query_1);
+  stats.add("C_query_2", pk.C_query_2);
+  stats.add("G_gamma2_Z_t", pk.G_gamma2_Z_t);
+  stats.print();
+}
+
+template<typename ppT>
+bool deserializeProvingKeyFromBinary(const uint8_t* data, size_t size, r1cs_se_ppzksnark_proving_key<ppT>& pk){
+  binary_reader reader(data, size);
+  binary_format_header header;
+  reader.read(header);
+  const bool compressed = header.flags & BINARY_FORMAT_COMPRESSED_POINTS;
+  bool ok = readQuery(reader, pk.A_query, header.flags)
+    && readQuery(reader, pk.B_query, header.flags)
+    && readQuery(reader, pk.C_query_1, header.flags)
+    && readQuery(reader, pk.C_query_2, header.flags)
+    && readPoint(reader, pk.G_gamma_Z, compressed)
+    && readPoint(reader, pk.H_gamma_Z, compressed)
+    && readPoint(reader, pk.G_ab_gamma_Z, compressed)
+    && readPoint(reader, pk.G_gamma2_Z2, compressed)
+    && readPoints(reader, pk.G_gamma2_Z_t, compressed);
+  return ok && readConstraintSystem(reader, pk.constraint_system) && reader.at_end();
+}
+
+// reads the binary format if the bytes carry its header, the libff stream format otherwise
+template<typename ppT>
+bool deserializeProvingKey(const byte_range& bytes, r1cs_se_ppzksnark_proving_key<ppT>& pk){
+  if (hasBinaryFormatMagic(bytes.data, bytes.length))
+    return checkBinaryFormatHeader<ppT>(bytes.data, bytes.length, BINARY_FORMAT_GM17)
+      && deserializeProvingKeyFromBinary<ppT>(bytes.data, bytes.length, pk);
+  return deserializeFromRange(bytes, pk);
+}
+
+template<typename ppT>
+bool deserializeProvingKeyFromFile(const char* pk_path, r1cs_se_ppzksnark_proving_key<ppT>& pk){
+  mapped_file file(pk_path);
+  byte_range bytes = { file.data(), file.size() };
+  return file.is_open() && deserializeProvingKey<ppT>(bytes, pk);
+}
+
+// fixed-base tables for the prover's A, B, C and H multi-exponentiations, with what they
+// record of the proving key file they were prepared from
+template<typename ppT>
+struct prepared_proving_key {
+  std::unique_ptr<mapped_file> file;
+  prepared_key_source key_source;
+  fixed_base_table<libff::G1<ppT>> A_query;
+  fixed_base_table<libff::G2<ppT>> B_query;
+  fixed_base_table<libff::G1<ppT>> C_query_1;
+  fixed_base_table<libff::G1<ppT>> C_query_2;
+  fixed_base_table<libff::G1<ppT>> G_gamma2_Z_t;
+};
+
+// the same bases, straight from the proving key
+template<typename ppT>
+struct proving_key_bases {
+  key_bases<libff::G1<ppT>> A_query;
+  key_bases<libff::G2<ppT>> B_query;
+  key_bases<libff::G1<ppT>> C_query_1;
+  key_bases<libff::G1<ppT>> C_query_2;
+  key_bases<libff::G1<ppT>> G_gamma2_Z_t;
+
+  explicit proving_key_bases(const r1cs_se_ppzksnark_proving_key<ppT>& pk)
+    : A_query(keyBases(pk.A_query)), B_query(keyBases(pk.B_query)), C_query_1(keyBases(pk.C_query_1)),
+      C_query_2(keyBases(pk.C_query_2)), G_gamma2_Z_t(keyBases(pk.G_gamma2_Z_t))
+  {
   }
+};
+
+template<typename ppT>
+bool prepareProvingKey(const char* pk_path, int window)
+{
+  r1cs_se_ppzksnark_proving_key<ppT> pk;
+  prepared_key_source key_source;
+  if (!deserializeProvingKeyFromFile<ppT>(pk_path, pk) || !keySource(pk_path, key_source))
+    return false;
 
-  return cs;
+  const size_t bits = libff::Fr<ppT>::size_in_bits();
+  binary_writer writer(preparedKeyPath(pk_path));
+  writer.write(binaryFormatHeader<ppT>(BINARY_FORMAT_GM17_PREPARED));
+  writeKeySource(writer, key_source);
+  writeFixedBaseTable<libff::G1<ppT>>(writer, pk.A_query.size(), bits, window, [&](size_t i) { return pk.A_query[i]; });
+  writeFixedBaseTable<libff::G2<ppT>>(writer, pk.B_query.size(), bits, window, [&](size_t i) { return pk.B_query[i]; });
+  writeFixedBaseTable<libff::G1<ppT>>(writer, pk.C_query_1.size(), bits, window, [&](size_t i) { return pk.C_query_1[i]; });
+  writeFixedBaseTable<libff::G1<ppT>>(writer, pk.C_query_2.size(), bits, window, [&](size_t i) { return pk.C_query_2[i]; });
+  writeFixedBaseTable<libff::G1<ppT>>(writer, pk.G_gamma2_Z_t.size(), bits, window, [&](size_t i) { return pk.G_gamma2_Z_t[i]; });
+  return writer.close();
 }
 
 template<typename ppT>
-void serializeProvingKeyToFile(r1cs_se_ppzksnark_proving_key<ppT> pk, const char* pk_path){
-  writeToFile(pk_path, pk);
+bool readPreparedProvingKey(const char* path, prepared_proving_key<ppT>& prepared)
+{
+  prepared.file.reset(new mapped_file(path));
+  const mapped_file& file = *prepared.file;
+  if (!file.is_open() || !hasBinaryFormatMagic(file.data(), file.size())
+      || !checkBinaryFormatHeader<ppT>(file.data(), file.size(), BINARY_FORMAT_GM17_PREPARED))
+    return false;
+
+  binary_reader reader(file.data(), file.size());
+  binary_format_header header;
+  return reader.read(header)
+    && readKeySource(reader, prepared.key_source)
+    && readFixedBaseTable(reader, prepared.A_query)
+    && readFixedBaseTable(reader, prepared.B_query)
+    && readFixedBaseTable(reader, prepared.C_query_1)
+    && readFixedBaseTable(reader, prepared.C_query_2)
+    && readFixedBaseTable(reader, prepared.G_gamma2_Z_t)
+    && reader.at_end();
 }
 
+// the prepared key next to pk_path, if there is one and it was prepared from the key file at pk_path
 template<typename ppT>
-r1cs_se_ppzksnark_proving_key<ppT> deserializeProvingKeyFromFile(const char* pk_path){
-  return loadFromFile<r1cs_se_ppzksnark_proving_key<ppT>>(pk_path);
+bool loadPreparedProvingKey(const char* pk_path, prepared_proving_key<ppT>& prepared)
+{
+  const std::string path = preparedKeyPath(pk_path);
+  if (access(path.c_str(), F_OK) != 0)
+    return false;
+  if (readPreparedProvingKey<ppT>(path.c_str(), prepared) && preparedFromKeyFile(prepared.key_source, pk_path))
+    return true;
+  std::cerr << "ignoring prepared proving key " << path << ", it was not prepared from " << pk_path << std::endl;
+  return false;
 }
 
-template<mp_size_t Q, typename ppT, typename G1T, typename G2T>
-void serializeVerificationKeyToFile(r1cs_se_ppzksnark_verification_key<ppT> vk, const char* vk_path){
-  std::stringstream ss;
+// r1cs_se_ppzksnark_prover with the multi-exponentiations over `bases`, either the tables of
+// a prepared_proving_key or the proving_key_bases
+template<typename ppT, typename Bases>
+r1cs_se_ppzksnark_proof<ppT> proveWithBases(const r1cs_se_ppzksnark_proving_key<ppT>& pk, const Bases& bases, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input)
+{
+  typedef libff::Fr<ppT> Fr;
+  const Fr d1 = Fr::random_element();
+  const Fr d2 = Fr::random_element();
 
+  libff::enter_block("Compute the polynomial H");
+  const sap_witness<Fr> sap_wit = r1cs_to_sap_witness_map(pk.constraint_system, primary_input, auxiliary_input, d1, d2);
+  libff::leave_block("Compute the polynomial H");
+
+  const Fr r = Fr::random_element();
+  const std::vector<Fr>& coefficients = sap_wit.coefficients_for_ACs;
+  const size_t inputs = sap_wit.num_inputs();
+
+  libff::enter_block("Compute the proof");
+  // A = gamma * (A_0(t) + sum input_i * A_i(t) + (r + d1) * Z(t)) in G1, B the same in G2
+  libff::G1<ppT> A = (r + sap_wit.d1) * pk.G_gamma_Z + pk.A_query[0]
+    + multiExp(bases.A_query, 1, coefficients.data(), coefficients.size());
+  libff::G2<ppT> B = (r + sap_wit.d1) * pk.H_gamma_Z + pk.B_query[0]
+    + multiExp(bases.B_query, 1, coefficients.data(), coefficients.size());
+  libff::G1<ppT> C = multiExp(bases.C_query_1, 0, coefficients.data() + inputs, coefficients.size() - inputs)
+    + (r * r) * pk.G_gamma2_Z2
+    + (r + sap_wit.d1) * pk.G_ab_gamma_Z
+    + r * pk.C_query_2[0]
+    + (r + r) * sap_wit.d1 * pk.G_gamma2_Z2
+    + r * multiExp(bases.C_query_2, 1, coefficients.data(), coefficients.size())
+    + sap_wit.d2 * pk.G_gamma2_Z_t[0]
+    + multiExp(bases.G_gamma2_Z_t, 0, sap_wit.coefficients_for_H.data(), sap_wit.coefficients_for_H.size());
+  libff::leave_block("Compute the proof");
+
+  return r1cs_se_ppzksnark_proof<ppT>(std::move(A), std::move(B), std::move(C));
+}
+
+// proves with the prepared tables when given some. Without tables, the key's bases are used
+// with the zero and one scalars set apart, which libsnark's GM17 prover does not do.
+template<typename ppT>
+r1cs_se_ppzksnark_proof<ppT> prove(const r1cs_se_ppzksnark_proving_key<ppT>& pk, const prepared_proving_key<ppT>* prepared, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input)
+{
+  if (prepared == nullptr)
+    return proveWithBases<ppT>(pk, proving_key_bases<ppT>(pk), primary_input, auxiliary_input);
+  return proveWithBases<ppT>(pk, *prepared, primary_input, auxiliary_input);
+}
+
+template<mp_size_t Q, typename ppT, typename G1T, typename G2T>
+std::string verificationKeyText(const r1cs_se_ppzksnark_verification_key<ppT>& vk){
   unsigned queryLength = vk.query.size();
 
-  ss << "\t\tvk.H = " << outputPointG2AffineAsHex<Q, G2T>(vk.H) << endl;
-  ss << "\t\tvk.Galpha = " << outputPointG1AffineAsHex<Q, G1T>(vk.G_alpha) << endl;
-  ss << "\t\tvk.Hbeta = " << outputPointG2AffineAsHex<Q, G2T>(vk.H_beta) << endl;
-  ss << "\t\tvk.Ggamma = " << outputPointG1AffineAsHex<Q, G1T>(vk.G_gamma) << endl;
-  ss << "\t\tvk.Hgamma = " << outputPointG2AffineAsHex<Q, G2T>(vk.H_gamma) << endl;
-  ss << "\t\tvk.query.len() = " << queryLength << endl;
-  for (mp_size_t i = 0; i < queryLength; ++i)
+  // one line per G2 point, G1 point and query entry
+  text_buffer out((queryLength + 6) * (32 + 4 * hexLength<Q>()));
+
+  out << "\t\tvk.H = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.H, false); out << "\n";
+  out << "\t\tvk.Galpha = "; appendPointG1AffineAsHex<Q, G1T>(out, vk.G_alpha, false); out << "\n";
+  out << "\t\tvk.Hbeta = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.H_beta, false); out << "\n";
+  out << "\t\tvk.Ggamma = "; appendPointG1AffineAsHex<Q, G1T>(out, vk.G_gamma, false); out << "\n";
+  out << "\t\tvk.Hgamma = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.H_gamma, false); out << "\n";
+  out << "\t\tvk.query.len() = " << queryLength << "\n";
+  for (size_t i = 0; i < queryLength; ++i)
   {
-      auto vkqueryi = outputPointG1AffineAsHex<Q, G1T>(vk.query[i]);
-      ss << "\t\tvk.query[" << i << "] = " << vkqueryi << endl;
+      out << "\t\tvk.query[" << i << "] = ";
+      appendPointG1AffineAsHex<Q, G1T>(out, vk.query[i], false);
+      out << "\n";
   }
 
-  std::ofstream fh;
-  fh.open(vk_path, std::ios::binary);
-  ss.rdbuf()->pubseekpos(0, std::ios_base::out);
-  fh << ss.rdbuf();
-  fh.flush();
-  fh.close();
+  return out.take();
 }
 
 template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
-void exportProof(r1cs_se_ppzksnark_proof<ppT> proof, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length){
+std::string proofJson(const r1cs_se_ppzksnark_proof<ppT>& proof, const r1cs_primary_input<libff::Fr<ppT>>& input){
     //create JSON file
-    std::stringstream ss;
-    ss << "{" << "\n";
-      ss << "\t\"proof\":" << "\n";
-        ss << "\t{" << "\n";
-          ss << "\t\t\"A\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.A) << ",\n";
-          ss << "\t\t\"B\":" << "\n";
-            ss << "\t\t\t" << outputPointG2AffineAsHexJson<Q, G2T>(proof.B) << ",\n";
-          ss << "\t\t\n";
-          ss << "\t\t\"C\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.C) << ",\n";
-        ss << "\t}," << "\n";
+    text_buffer out(128 + 8 * hexLength<Q>() + input.size() * (hexLength<R>() + 3));
+    out << "{" << "\n";
+      out << "\t\"proof\":" << "\n";
+        out << "\t{" << "\n";
+          out << "\t\t\"A\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.A, true); out << ",\n";
+          out << "\t\t\"B\":" << "\n";
+            out << "\t\t\t"; appendPointG2AffineAsHex<Q, G2T>(out, proof.B, true); out << ",\n";
+          out << "\t\t\n";
+          out << "\t\t\"C\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.C, true); out << ",\n";
+        out << "\t}," << "\n";
       //add input to json
-      ss << "\t\"input\":" << "[";
-      for (int i = 1; i < public_inputs_length; i++) {
-        if(i!=1){
-          ss << ",";
+      out << "\t\"input\":" << "[";
+      for (size_t i = 0; i < input.size(); i++) {
+        if(i!=0){
+          out << ",";
         }
-        ss << outputInputAsHex<R>(libsnarkBigintFromBytes<R>(public_inputs + i*R*mp_limb_t_size));
+        out << "\""; out.hex<R>(input[i].as_bigint()); out << "\"";
       }
-      ss << "]" << "\n";
-    ss << "}" << "\n";
+      out << "]" << "\n";
+    out << "}" << "\n";
 
-    std::string s = ss.str();
-    //write json string to proof_path
-    writeToFile(proof_path, s);
+    return out.take();
 }
 
 template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
-bool setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+void exportProof(const r1cs_se_ppzksnark_proof<ppT>& proof, const r1cs_primary_input<libff::Fr<ppT>>& input, proof_bytes& out)
 {
-  auto cs = gm17::createConstraintSystem<R, ppT>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs);
-  assert(cs.num_variables() >= (unsigned)inputs);
-  assert(cs.num_inputs() == (unsigned)inputs);
-  assert(cs.num_constraints() == (unsigned)constraints);
+  out.json = gm17::proofJson<Q, R, ppT, G1T, G2T>(proof, input);
+  // proof and primary input in raw format (easy verify)
+  out.raw = serializeToString(proof);
+  out.input = serializeVectorToString(input);
+}
+
+// `cs` is released once the keys are generated, the proving key holding its own copy; `vk` is
+// a path or a vk_bytes, see storeVerificationKey
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T, typename VkOut>
+bool setup(r1cs_se_ppzksnark_constraint_system<ppT>& cs, binary_writer& pk, VkOut& vk)
+{
+  profile_phase generation("key_generation");
   auto keypair = r1cs_se_ppzksnark_generator<libff::alt_bn128_pp>(cs);
-  gm17::serializeProvingKeyToFile<ppT>(keypair.pk, pk_path);
-  gm17::serializeVerificationKeyToFile<Q, ppT, G1T, G2T>(keypair.vk, vk_path);
+  cs = r1cs_se_ppzksnark_constraint_system<ppT>();
+  releaseFreeMemory();
+  generation.end();
+  if (binaryFormatFlagsFromEnv() & BINARY_FORMAT_SPARSE_QUERIES)
+    gm17::printPruningStats<ppT>(keypair.pk);
+  profile_phase serialization("key_serialization");
+  // vk in raw format (easy verify)
+  if (!storeVerificationKey(gm17::verificationKeyText<Q, ppT, G1T, G2T>(keypair.vk), keypair.vk, vk))
+    return false;
+  gm17::serializeProvingKey<ppT>(pk, keypair.pk);
   return true;
 }
 
+// writes the keys to pk_path, vk_path and vk_path.raw, and stores them as `entry`, see
+// setup_cache.tcc. The previous keys stay in place until the new ones are complete.
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(r1cs_se_ppzksnark_constraint_system<ppT>& cs, const char* pk_path, const char* vk_path, const std::string& entry)
+{
+  const setup_outputs tmp = temporarySetupOutputs(pk_path, vk_path);
+  const setup_outputs outputs(pk_path, vk_path);
+  const char* tmp_vk_path = tmp.vk.c_str();
+  binary_writer pk(tmp.pk);
+  if (!setup<Q, R, ppT, G1T, G2T>(cs, pk, tmp_vk_path) || !pk.close() || !replaceSetupOutputs(tmp, outputs)) {
+    removeSetupOutputs(tmp);
+    return false;
+  }
+  storeSetupKeys(entry, outputs);
+  return true;
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(r1cs_se_ppzksnark_constraint_system<ppT>& cs, buffer* pk_out, vk_buffers* vk_out)
+{
+  std::string pk_bytes;
+  binary_writer pk(&pk_bytes);
+  vk_bytes vk;
+  if (!setup<Q, R, ppT, G1T, G2T>(cs, pk, vk) || !toBuffer(pk_bytes, pk_out))
+    return false;
+  if (toBuffers(vk, vk_out))
+    return true;
+  _free_buffer(pk_out);
+  return false;
+}
+
+// the stored keys of the same rows when there are some, copied to pk_path, vk_path and
+// vk_path.raw before any constraint system is built
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+{
+  const std::string entry = setupKeysEntry<ppT>(BINARY_FORMAT_GM17, [&] {
+    return r1cs_builder<R, libff::Fr<ppT>>::rowsDigest(A, B, C, A_len, B_len, C_len, constraints, variables, inputs);
+  });
+  if (restoreSetupKeys(entry, pk_path, vk_path))
+    return true;
+  r1cs_se_ppzksnark_constraint_system<ppT> cs;
+  return gm17::createConstraintSystem<R, ppT>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, cs)
+    && setup<Q, R, ppT, G1T, G2T>(cs, pk_path, vk_path, entry);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, buffer* pk, vk_buffers* vk)
+{
+  r1cs_se_ppzksnark_constraint_system<ppT> cs;
+  return gm17::createConstraintSystem<R, ppT>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, cs)
+    && setup<Q, R, ppT, G1T, G2T>(cs, pk, vk);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(constraint_chunk_callback next_chunk, void* state, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+{
+  profile_phase building("constraint_building");
+  r1cs_se_ppzksnark_constraint_system<ppT> cs;
+  if (!streamConstraintSystem<R, libff::Fr<ppT>>(next_chunk, state, constraints, variables, inputs, cs))
+    return false;
+  building.end();
+  // the rows are gone by now, so the store goes by the built constraint system
+  const std::string entry = setupKeysEntry<ppT>(BINARY_FORMAT_GM17, [&] { return constraintSystemDigest(cs); });
+  if (restoreSetupKeys(entry, pk_path, vk_path))
+    return true;
+  return setup<Q, R, ppT, G1T, G2T>(cs, pk_path, vk_path, entry);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const r1cs_se_ppzksnark_proving_key<ppT>& pk, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input, proof_bytes& out, const prepared_proving_key<ppT>* prepared = nullptr)
+{
+  profile_phase proving("prove");
+  auto proof = gm17::prove<ppT>(pk, prepared, primary_input, auxiliary_input);
+  proving.end();
+  profile_phase exporting("proof_export");
+  gm17::exportProof<Q, R, ppT, G1T, G2T>(proof, primary_input, out);
+  return true;
+}
+
+// writes the proof to proof_path, proof_path.raw and proof_path.input.raw
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const r1cs_se_ppzksnark_proving_key<ppT>& pk, const char* proof_path, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input, const prepared_proving_key<ppT>* prepared = nullptr)
+{
+  proof_bytes proof;
+  return gm17::generate_proof<Q, R, ppT, G1T, G2T>(pk, primary_input, auxiliary_input, proof, prepared) && writeProofFiles(proof, proof_path);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const r1cs_se_ppzksnark_proving_key<ppT>& pk, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, const prepared_proving_key<ppT>* prepared = nullptr)
+{
+  r1cs_primary_input<libff::Fr<ppT>> primary_input;
+  r1cs_auxiliary_input<libff::Fr<ppT>> auxiliary_input;
+  profile_phase marshalling("witness_marshalling");
+  witnessFromBytes<R>(public_inputs, public_inputs_length, private_inputs, private_inputs_length, primary_input, auxiliary_input);
+  marshalling.end();
+  return gm17::generate_proof<Q, R, ppT, G1T, G2T>(pk, proof_path, primary_input, auxiliary_input, prepared);
+}
+
 template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
 bool generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length)
 {
-  auto pk = gm17::deserializeProvingKeyFromFile<ppT>(pk_path);
-  r1cs_variable_assignment<libff::Fr<libff::alt_bn128_pp> > full_variable_assignment;
-  for (int i = 1; i < public_inputs_length; i++) {
-    full_variable_assignment.push_back(libff::Fr<libff::alt_bn128_pp>(libsnarkBigintFromBytes<R>(public_inputs + i*R*mp_limb_t_size)));
+  profile_phase deserialization("key_deserialization");
+  r1cs_se_ppzksnark_proving_key<ppT> pk;
+  if (!gm17::deserializeProvingKeyFromFile<ppT>(pk_path, pk))
+    return false;
+  prepared_proving_key<ppT> prepared;
+  const bool has_prepared = gm17::loadPreparedProvingKey<ppT>(pk_path, prepared);
+  deserialization.end();
+  return gm17::generate_proof<Q, R, ppT, G1T, G2T>(pk, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length, has_prepared ? &prepared : nullptr);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const char* pk_path, const char* proof_path, uint64_t* witness, int public_inputs_length, int variables)
+{
+  profile_phase deserialization("key_deserialization");
+  r1cs_se_ppzksnark_proving_key<ppT> pk;
+  if (!gm17::deserializeProvingKeyFromFile<ppT>(pk_path, pk))
+    return false;
+  prepared_proving_key<ppT> prepared;
+  const bool has_prepared = gm17::loadPreparedProvingKey<ppT>(pk_path, prepared);
+  deserialization.end();
+  r1cs_primary_input<libff::Fr<ppT>> primary_input;
+  r1cs_auxiliary_input<libff::Fr<ppT>> auxiliary_input;
+  profile_phase marshalling("witness_marshalling");
+  witnessFromLimbs<R>(witness, public_inputs_length, variables, primary_input, auxiliary_input);
+  marshalling.end();
+  return gm17::generate_proof<Q, R, ppT, G1T, G2T>(pk, proof_path, primary_input, auxiliary_input, has_prepared ? &prepared : nullptr);
+}
+
+// proves every witness against one key, loaded once, writing proof i to proof_paths[i];
+// results[i] tells whether it was written. Witnesses are laid out as for the limbs prover
+// above, and are proven concurrently in multicore builds.
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proofs(const char* pk_path, const char* const* proof_paths, uint64_t* const* witnesses, int count, int public_inputs_length, int variables, bool* results)
+{
+  std::fill(results, results + count, false);
+  profile_phase deserialization("key_deserialization");
+  r1cs_se_ppzksnark_proving_key<ppT> pk;
+  if (!gm17::deserializeProvingKeyFromFile<ppT>(pk_path, pk))
+    return false;
+  prepared_proving_key<ppT> prepared;
+  const bool has_prepared = gm17::loadPreparedProvingKey<ppT>(pk_path, prepared);
+  deserialization.end();
+
+  std::vector<r1cs_primary_input<libff::Fr<ppT>>> primary_inputs(count);
+  std::vector<r1cs_auxiliary_input<libff::Fr<ppT>>> auxiliary_inputs(count);
+  profile_phase marshalling("witness_marshalling");
+  for (int i = 0; i < count; i++)
+    witnessFromLimbs<R>(witnesses[i], public_inputs_length, variables, primary_inputs[i], auxiliary_inputs[i]);
+  marshalling.end();
+
+  profile_phase proving("prove");
+  std::vector<r1cs_se_ppzksnark_proof<ppT>> proofs(count);
+  {
+    libff_timers_paused paused;
+    forEachProof(count, [&](int i) {
+      proofs[i] = gm17::prove<ppT>(pk, has_prepared ? &prepared : nullptr, primary_inputs[i], auxiliary_inputs[i]);
+    });
   }
-  for (int i = 0; i < private_inputs_length; i++) {
-    full_variable_assignment.push_back(libff::Fr<libff::alt_bn128_pp>(libsnarkBigintFromBytes<R>(private_inputs + i*R*mp_limb_t_size)));
+  proving.end();
+
+  profile_phase exporting("proof_export");
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < count; i++) {
+    proof_bytes proof;
+    gm17::exportProof<Q, R, ppT, G1T, G2T>(proofs[i], primary_inputs[i], proof);
+    results[i] = writeProofFiles(proof, proof_paths[i]);
   }
-  r1cs_primary_input<libff::Fr<libff::alt_bn128_pp>> primary_input(full_variable_assignment.begin(), full_variable_assignment.begin() + public_inputs_length-1);
-  r1cs_primary_input<libff::Fr<libff::alt_bn128_pp>> auxiliary_input(full_variable_assignment.begin() + public_inputs_length-1, full_variable_assignment.end());
-  auto proof = r1cs_se_ppzksnark_prover<libff::alt_bn128_pp>(pk, primary_input, auxiliary_input);
-  gm17::exportProof<Q, R, ppT, G1T, G2T>(proof, proof_path, public_inputs, public_inputs_length);
-  return true;
+  return std::all_of(results, results + count, [](bool ok) { return ok; });
 }
 
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const byte_range& pk_bytes, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, proof_buffers* out)
+{
+  profile_phase deserialization("key_deserialization");
+  r1cs_se_ppzksnark_proving_key<ppT> pk;
+  if (!gm17::deserializeProvingKey<ppT>(pk_bytes, pk))
+    return false;
+  deserialization.end();
+  r1cs_primary_input<libff::Fr<ppT>> primary_input;
+  r1cs_auxiliary_input<libff::Fr<ppT>> auxiliary_input;
+  profile_phase marshalling("witness_marshalling");
+  witnessFromBytes<R>(public_inputs, public_inputs_length, private_inputs, private_inputs_length, primary_input, auxiliary_input);
+  marshalling.end();
+  proof_bytes proof;
+  return gm17::generate_proof<Q, R, ppT, G1T, G2T>(pk, primary_input, auxiliary_input, proof) && toBuffers(proof, out);
 }
 
-bool _gm17_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+// verifies every proof against one vk, processed once; results[i] tells whether proof i holds.
+// Proofs without bytes count as failed.
+template<typename ppT>
+bool verify_proofs(const byte_range& vk_raw, const proof_range* proofs, int count, bool* results)
+{
+  profile_phase loading("key_deserialization");
+  auto vk = deserializeFromRange<r1cs_se_ppzksnark_verification_key<ppT>>(vk_raw);
+  auto pvk = r1cs_se_ppzksnark_verifier_process_vk<ppT>(vk);
+
+  std::vector<r1cs_se_ppzksnark_proof<ppT>> parsed(count);
+  std::vector<r1cs_primary_input<libff::Fr<ppT>>> inputs(count);
+  std::vector<char> loaded(count);
+  for (int i = 0; i < count; i++) {
+    loaded[i] = proofs[i].raw.data != nullptr && proofs[i].input.data != nullptr;
+    if (loaded[i]) {
+      parsed[i] = deserializeFromRange<r1cs_se_ppzksnark_proof<ppT>>(proofs[i].raw);
+      inputs[i] = deserializeVectorFromRange<libff::Fr<ppT>>(proofs[i].input);
+    }
+  }
+  loading.end();
+
+  profile_phase verification("verification");
+  libff_timers_paused paused;
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < count; i++)
+    results[i] = loaded[i] && r1cs_se_ppzksnark_online_verifier_strong_IC<ppT>(pvk, inputs[i], parsed[i]);
+
+  return std::all_of(results, results + count, [](bool ok) { return ok; });
+}
+
+// reads the raw vk and proofs next to the given paths
+template<typename ppT>
+bool verify_proofs(const char* vk_path, const char* const* proof_paths, int count, bool* results)
+{
+  std::string vk_raw;
+  if (!readVerificationKeyFile(vk_path, vk_raw)) {
+    std::fill(results, results + count, false);
+    return false;
+  }
+  std::vector<std::string> storage;
+  std::vector<proof_range> proofs = readProofs(proof_paths, count, storage);
+  return verify_proofs<ppT>(rangeOf(vk_raw), proofs.data(), count, results);
+}
+
+template<typename ppT>
+bool verify_proof(const char* vk_path, const char* proof_path)
 {
+  bool result;
+  return verify_proofs<ppT>(vk_path, &proof_path, 1, &result);
+}
+
+// long-lived prover: curve parameters are initialised once and proving keys stay loaded between proofs
+class context {
+  public:
+    context() : keys(gm17::deserializeProvingKeyFromFile<libff::alt_bn128_pp>), prepared_keys(gm17::readPreparedProvingKey<libff::alt_bn128_pp>)
+    {
+      libff::inhibit_profiling_info = true;
+      libff::inhibit_profiling_counters = true;
+      libff::alt_bn128_pp::init_public_params();
+    }
+
+    bool generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length)
+    {
+      profile_phase deserialization("key_deserialization");
+      std::string key_digest;
+      auto pk = keys.get(pk_path, &key_digest);
+      if (!pk)
+        return false;
+      auto prepared = prepared_keys.get(preparedKeyPath(pk_path).c_str());
+      if (prepared && prepared->key_source.digest != key_digest)
+        prepared = nullptr;
+      deserialization.end();
+      return gm17::generate_proof<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(*pk, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length, prepared.get());
+    }
+
+  private:
+    key_cache<r1cs_se_ppzksnark_proving_key<libff::alt_bn128_pp>> keys;
+    key_cache<prepared_proving_key<libff::alt_bn128_pp>> prepared_keys;
+};
+
+}
+
+bool _gm17_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
+{
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_setup");
   return gm17::setup<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk_path, vk_path);
 }
 
-bool _gm17_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length)
+bool _gm17_setup_streamed(constraint_chunk_callback next_chunk, void* state, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_setup_streamed");
+  return gm17::setup<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(next_chunk, state, constraints, variables, inputs, pk_path, vk_path);
+}
+
+bool _gm17_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, int threads)
 {
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_generate_proof");
   return gm17::generate_proof<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk_path, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length);
 }
+
+bool _gm17_generate_proof_limbs(const char* pk_path, const char* proof_path, uint64_t* witness, int public_inputs_length, int variables, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_generate_proof_limbs");
+  return gm17::generate_proof<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk_path, proof_path, witness, public_inputs_length, variables);
+}
+
+bool _gm17_generate_proofs_limbs(const char* pk_path, const char* const* proof_paths, uint64_t* const* witnesses, int count, int public_inputs_length, int variables, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_generate_proofs_limbs");
+  return gm17::generate_proofs<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk_path, proof_paths, witnesses, count, public_inputs_length, variables, results);
+}
+
+bool _gm17_verify_proof(const char* vk_path, const char* proof_path)
+{
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_verify_proof");
+  return gm17::verify_proof<libff::alt_bn128_pp>(vk_path, proof_path);
+}
+
+bool _gm17_verify_proofs(const char* vk_path, const char* const* proof_paths, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_verify_proofs");
+  return gm17::verify_proofs<libff::alt_bn128_pp>(vk_path, proof_paths, count, results);
+}
+
+bool _gm17_setup_buffers(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, struct buffer* pk, struct vk_buffers* vk, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_setup_buffers");
+  return gm17::setup<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk, vk);
+}
+
+bool _gm17_generate_proof_buffers(struct byte_range pk, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, struct proof_buffers* proof, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_generate_proof_buffers");
+  return gm17::generate_proof<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk, public_inputs, public_inputs_length, private_inputs, private_inputs_length, proof);
+}
+
+bool _gm17_verify_proofs_buffers(struct byte_range vk, const struct proof_range* proofs, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_verify_proofs_buffers");
+  return gm17::verify_proofs<libff::alt_bn128_pp>(vk, proofs, count, results);
+}
+
+bool _gm17_prepare_proving_key(const char* pk_path, int window, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("gm17_prepare_proving_key");
+  return gm17::prepareProvingKey<libff::alt_bn128_pp>(pk_path, window);
+}
+
+void* _gm17_context_new()
+{
+  return new gm17::context();
+}
+
+void _gm17_context_free(void* context)
+{
+  delete (gm17::context*) context;
+}
+
+bool _gm17_context_generate_proof(void* context, const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, int threads)
+{
+  setThreads(threads);
+  profile_call profile("gm17_context_generate_proof");
+  return ((gm17::context*) context)->generate_proof(pk_path, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length);
+}
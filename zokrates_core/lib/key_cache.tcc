@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * @file key_cache.tcc
+ * Proving keys kept resident between proofs by a long-lived prover context.
+ */
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "util.tcc"
+#include "binary_format.tcc"
+
+// caches loaded keys by path; an entry is reloaded when the file's size, inode or
+// mtime changes, and paths whose contents hash the same share one key
+template<typename PkT>
+class key_cache {
+  public:
+    typedef bool (*loader_t)(const char*, PkT&);
+
+    key_cache(loader_t loader) : loader(loader) {}
+
+    // the key at `path`, and the SHA-256 of its file in `digest_out` if given
+    std::shared_ptr<const PkT> get(const char* path, std::string* digest_out = nullptr)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      file_identity identity;
+      if (!fileIdentity(path, identity))
+        return nullptr;
+
+      auto it = entries.find(path);
+      if (it != entries.end() && it->second.identity == identity) {
+        if (digest_out != nullptr)
+          *digest_out = it->second.digest;
+        return it->second.pk;
+      }
+
+      std::string digest;
+      if (!fileDigest(path, digest))
+        return nullptr;
+
+      std::shared_ptr<const PkT> pk = by_digest[digest].lock();
+      if (!pk) {
+        std::shared_ptr<PkT> loaded = std::make_shared<PkT>();
+        if (!loader(path, *loaded))
+          return nullptr;
+        by_digest[digest] = loaded;
+        pk = loaded;
+      }
+
+      entry e;
+      e.digest = digest;
+      e.identity = identity;
+      e.pk = pk;
+      entries[path] = e;
+      if (digest_out != nullptr)
+        *digest_out = digest;
+      return pk;
+    }
+
+  private:
+    struct entry {
+      std::string digest;
+      file_identity identity;
+      std::shared_ptr<const PkT> pk;
+    };
+
+    loader_t loader;
+    std::mutex mutex;
+    std::map<std::string, entry> entries;
+    std::map<std::string, std::weak_ptr<const PkT>> by_digest;
+};
@@ -10,6 +10,8 @@
 #include <iostream>
 #include <cassert>
 #include <iomanip>
+#include <algorithm>
+#include <array>
 
 // contains definition of alt_bn128 ec public parameters
 #include "libff/algebra/curves/alt_bn128/alt_bn128_pp.hpp"
@@ -20,6 +22,14 @@
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
 
 #include "util.tcc"
+#include "binary_format.tcc"
+#include "buffer.tcc"
+#include "key_cache.tcc"
+#include "r1cs_builder.tcc"
+#include "witness.tcc"
+#include "profiling.tcc"
+#include "prover.tcc"
+#include "setup_cache.tcc"
 // contains aggregation circuit
 #include "aggregator.tcc"
 
@@ -32,352 +42,1384 @@ namespace pghr13 {
 
 //takes input and puts it into constraint system
 template<mp_size_t R, typename ppT>
-r1cs_ppzksnark_constraint_system<ppT> createConstraintSystem(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs)
+bool createConstraintSystem(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, r1cs_ppzksnark_constraint_system<ppT>& cs)
 {
-  r1cs_ppzksnark_constraint_system<ppT> cs;
-  cs.primary_input_size = inputs;
-  cs.auxiliary_input_size = variables - inputs - 1; // ~one not included
+  profile_phase building("constraint_building");
+  if (!buildConstraintSystem<R, libff::Fr<ppT>>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, cs))
+    return false;
+  building.end();
+  assert(cs.num_variables() >= (unsigned)inputs);
+  assert(cs.num_inputs() == (unsigned)inputs);
+  return true;
+}
 
-  cout << "num variables: " << variables <<endl;
-  cout << "num constraints: " << constraints <<endl;
-  cout << "num inputs: " << inputs <<endl;
+template<typename ppT>
+void serializeProvingKey(binary_writer& writer, const r1cs_ppzksnark_proving_key<ppT>& pk) {
+  const uint32_t flags = binaryFormatFlagsFromEnv();
+  const bool compressed = flags & BINARY_FORMAT_COMPRESSED_POINTS;
+  writer.write(binaryFormatHeader<ppT>(BINARY_FORMAT_PGHR13, flags));
+  writeSparseVector(writer, pk.A_query, compressed);
+  writeSparseVector(writer, pk.B_query, compressed);
+  writeSparseVector(writer, pk.C_query, compressed);
+  writePoints(writer, pk.H_query, compressed);
+  writeQuery(writer, pk.K_query, flags);
+  writeConstraintSystem(writer, pk.constraint_system);
+}
 
-  struct VariableValueMapping {
-    int constraint_id;
-    int variable_id;
-    uint8_t variable_value[R*mp_limb_t_size];
-  };
-  const VariableValueMapping* A_vvmap = (VariableValueMapping*) A;
-  const VariableValueMapping* B_vvmap = (VariableValueMapping*) B;
-  const VariableValueMapping* C_vvmap = (VariableValueMapping*) C;
-
-  int A_id = 0;
-  int B_id = 0;
-  int C_id = 0;
-
-  for (int row = 0; row < constraints; row++) {
-    linear_combination<libff::Fr<ppT> > lin_comb_A, lin_comb_B, lin_comb_C;
-
-    while (A_id < A_len && A_vvmap[A_id].constraint_id == row) {
-      libff::bigint<R> value = libsnarkBigintFromBytes<R>(A_vvmap[A_id].variable_value);
-      if (!value.is_zero())
-        lin_comb_A.add_term(A_vvmap[A_id].variable_id, value);
-      A_id++;
-    }
-    while (B_id < B_len && B_vvmap[B_id].constraint_id == row) {
-      libff::bigint<R> value = libsnarkBigintFromBytes<R>(B_vvmap[B_id].variable_value);
-      if (!value.is_zero())
-        lin_comb_B.add_term(B_vvmap[B_id].variable_id, value);
-      B_id++;
-    }
-    while (C_id < C_len && C_vvmap[C_id].constraint_id == row) {
-      libff::bigint<R> value = libsnarkBigintFromBytes<R>(C_vvmap[C_id].variable_value);
-      if (!value.is_zero())
-        lin_comb_C.add_term(C_vvmap[C_id].variable_id, value);
-      C_id++;
-    }
+// A, B and C are sparse already; H_query holds powers of t, none of them zero
+template<typename ppT>
+void printPruningStats(const r1cs_ppzksnark_proving_key<ppT>& pk)
+{
+  query_pruning_stats stats;
+  stats.add("A_query", pk.A_query);
+  stats.add("B_query", pk.B_query);
+  stats.add("C_query", pk.C_query);
+  stats.add("H_query", pk.H_query);
+  stats.add("K_query", pk.K_query);
+  stats.print();
+}
 
-    cs.add_constraint(r1cs_constraint<libff::Fr<ppT> >(lin_comb_A, lin_comb_B, lin_comb_C));
-  }
+template<typename ppT>
+bool serializeProvingKeyToFile(const r1cs_ppzksnark_proving_key<ppT>& pk, const char* pk_path) {
+  binary_writer writer(pk_path);
+  serializeProvingKey<ppT>(writer, pk);
+  return writer.close();
+}
 
-  return cs;
+template<typename ppT>
+bool deserializeProvingKeyFromBinary(const uint8_t* data, size_t size, r1cs_ppzksnark_proving_key<ppT>& pk) {
+  binary_reader reader(data, size);
+  binary_format_header header;
+  reader.read(header);
+  const bool compressed = header.flags & BINARY_FORMAT_COMPRESSED_POINTS;
+  bool ok = readSparseVector(reader, pk.A_query, compressed)
+    && readSparseVector(reader, pk.B_query, compressed)
+    && readSparseVector(reader, pk.C_query, compressed)
+    && readPoints(reader, pk.H_query, compressed)
+    && readQuery(reader, pk.K_query, header.flags);
+  return ok && readConstraintSystem(reader, pk.constraint_system) && reader.at_end();
 }
 
+// reads the binary format if the bytes carry its header, the libff stream format otherwise
 template<typename ppT>
-void serializeProvingKeyToFile(r1cs_ppzksnark_proving_key<ppT> pk, const char* pk_path) {
-  writeToFile(pk_path, pk);
+bool deserializeProvingKey(const byte_range& bytes, r1cs_ppzksnark_proving_key<ppT>& pk) {
+  if (hasBinaryFormatMagic(bytes.data, bytes.length))
+    return checkBinaryFormatHeader<ppT>(bytes.data, bytes.length, BINARY_FORMAT_PGHR13)
+      && deserializeProvingKeyFromBinary<ppT>(bytes.data, bytes.length, pk);
+  return deserializeFromRange(bytes, pk);
 }
 
 template<typename ppT>
-r1cs_ppzksnark_proving_key<ppT> deserializeProvingKeyFromFile(const char* pk_path) {
-  return loadFromFile<r1cs_ppzksnark_proving_key<ppT>>(pk_path);
+bool deserializeProvingKeyFromFile(const char* pk_path, r1cs_ppzksnark_proving_key<ppT>& pk) {
+  mapped_file file(pk_path);
+  byte_range bytes = { file.data(), file.size() };
+  return file.is_open() && deserializeProvingKey<ppT>(bytes, pk);
 }
 
-template<mp_size_t Q, typename ppT, typename G1T, typename G2T>
-void serializeVerificationKeyToFile(r1cs_ppzksnark_verification_key<ppT> vk, const char* vk_path) {
-  std::stringstream ss;
+// fixed-base tables for the prover's multi-exponentiations, both halves of each knowledge
+// commitment query on its own, with what they record of the proving key file they were prepared from
+template<typename ppT>
+struct prepared_proving_key {
+  std::unique_ptr<mapped_file> file;
+  prepared_key_source key_source;
+  fixed_base_table<libff::G1<ppT>> A_g;
+  fixed_base_table<libff::G1<ppT>> A_h;
+  fixed_base_table<libff::G2<ppT>> B_g;
+  fixed_base_table<libff::G1<ppT>> B_h;
+  fixed_base_table<libff::G1<ppT>> C_g;
+  fixed_base_table<libff::G1<ppT>> C_h;
+  fixed_base_table<libff::G1<ppT>> H_query;
+  fixed_base_table<libff::G1<ppT>> K_query;
+};
+
+template<typename ppT>
+bool prepareProvingKey(const char* pk_path, int window)
+{
+  r1cs_ppzksnark_proving_key<ppT> pk;
+  prepared_key_source key_source;
+  if (!deserializeProvingKeyFromFile<ppT>(pk_path, pk) || !keySource(pk_path, key_source))
+    return false;
+
+  typedef libff::G1<ppT> G1;
+  typedef libff::G2<ppT> G2;
+  const size_t bits = libff::Fr<ppT>::size_in_bits();
+  const auto& A = pk.A_query.values;
+  const auto& B = pk.B_query.values;
+  const auto& C = pk.C_query.values;
+  binary_writer writer(preparedKeyPath(pk_path));
+  writer.write(binaryFormatHeader<ppT>(BINARY_FORMAT_PGHR13_PREPARED));
+  writeKeySource(writer, key_source);
+  writeFixedBaseTable<G1>(writer, A.size(), bits, window, [&](size_t i) { return A[i].g; });
+  writeFixedBaseTable<G1>(writer, A.size(), bits, window, [&](size_t i) { return A[i].h; });
+  writeFixedBaseTable<G2>(writer, B.size(), bits, window, [&](size_t i) { return B[i].g; });
+  writeFixedBaseTable<G1>(writer, B.size(), bits, window, [&](size_t i) { return B[i].h; });
+  writeFixedBaseTable<G1>(writer, C.size(), bits, window, [&](size_t i) { return C[i].g; });
+  writeFixedBaseTable<G1>(writer, C.size(), bits, window, [&](size_t i) { return C[i].h; });
+  writeFixedBaseTable<G1>(writer, pk.H_query.size(), bits, window, [&](size_t i) { return pk.H_query[i]; });
+  writeFixedBaseTable<G1>(writer, pk.K_query.size(), bits, window, [&](size_t i) { return pk.K_query[i]; });
+  return writer.close();
+}
+
+template<typename ppT>
+bool readPreparedProvingKey(const char* path, prepared_proving_key<ppT>& prepared)
+{
+  prepared.file.reset(new mapped_file(path));
+  const mapped_file& file = *prepared.file;
+  if (!file.is_open() || !hasBinaryFormatMagic(file.data(), file.size())
+      || !checkBinaryFormatHeader<ppT>(file.data(), file.size(), BINARY_FORMAT_PGHR13_PREPARED))
+    return false;
+
+  binary_reader reader(file.data(), file.size());
+  binary_format_header header;
+  return reader.read(header)
+    && readKeySource(reader, prepared.key_source)
+    && readFixedBaseTable(reader, prepared.A_g)
+    && readFixedBaseTable(reader, prepared.A_h)
+    && readFixedBaseTable(reader, prepared.B_g)
+    && readFixedBaseTable(reader, prepared.B_h)
+    && readFixedBaseTable(reader, prepared.C_g)
+    && readFixedBaseTable(reader, prepared.C_h)
+    && readFixedBaseTable(reader, prepared.H_query)
+    && readFixedBaseTable(reader, prepared.K_query)
+    && reader.at_end();
+}
+
+// the prepared key next to pk_path, if there is one and it was prepared from the key file at pk_path
+template<typename ppT>
+bool loadPreparedProvingKey(const char* pk_path, prepared_proving_key<ppT>& prepared)
+{
+  const std::string path = preparedKeyPath(pk_path);
+  if (access(path.c_str(), F_OK) != 0)
+    return false;
+  if (readPreparedProvingKey<ppT>(path.c_str(), prepared) && preparedFromKeyFile(prepared.key_source, pk_path))
+    return true;
+  std::cerr << "ignoring prepared proving key " << path << ", it was not prepared from " << pk_path << std::endl;
+  return false;
+}
+
+// scalar of each value of a sparse query: the coefficient of the variable at its index, zero
+// for the constant and randomness terms at index 0 and past the variables
+template<typename FieldT, typename T>
+std::vector<FieldT> sparseQueryScalars(const sparse_vector<T>& query, const std::vector<FieldT>& coefficients, size_t variables)
+{
+  std::vector<FieldT> scalars(query.indices.size(), FieldT::zero());
+  for (size_t k = 0; k < query.indices.size(); k++) {
+    const size_t index = query.indices[k];
+    if (index >= 1 && index <= variables)
+      scalars[k] = coefficients[index - 1];
+  }
+  return scalars;
+}
+
+// r1cs_ppzksnark_prover with the multi-exponentiations over the prepared tables. libsnark's
+// prover already sets the zero and one scalars apart, and so does fixedBaseMultiExp.
+template<typename ppT>
+r1cs_ppzksnark_proof<ppT> proveWithTables(const r1cs_ppzksnark_proving_key<ppT>& pk, const prepared_proving_key<ppT>& prepared, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input)
+{
+  typedef libff::Fr<ppT> Fr;
+  typedef libff::G1<ppT> G1;
+  typedef libff::G2<ppT> G2;
+  const Fr d1 = Fr::random_element();
+  const Fr d2 = Fr::random_element();
+  const Fr d3 = Fr::random_element();
+
+  libff::enter_block("Compute the polynomial H");
+  const qap_witness<Fr> qap_wit = r1cs_to_qap_witness_map(pk.constraint_system, primary_input, auxiliary_input, d1, d2, d3);
+  libff::leave_block("Compute the polynomial H");
+
+  const size_t variables = qap_wit.num_variables();
+  const std::vector<Fr>& coefficients = qap_wit.coefficients_for_ABCs;
+  const std::vector<Fr> A_scalars = sparseQueryScalars(pk.A_query, coefficients, variables);
+  const std::vector<Fr> B_scalars = sparseQueryScalars(pk.B_query, coefficients, variables);
+  const std::vector<Fr> C_scalars = sparseQueryScalars(pk.C_query, coefficients, variables);
+
+  libff::enter_block("Compute the proof");
+  knowledge_commitment<G1, G1> g_A = pk.A_query[0] + qap_wit.d1 * pk.A_query[variables + 1]
+    + knowledge_commitment<G1, G1>(
+        fixedBaseMultiExp(prepared.A_g, 0, A_scalars.data(), A_scalars.size()),
+        fixedBaseMultiExp(prepared.A_h, 0, A_scalars.data(), A_scalars.size()));
+  knowledge_commitment<G2, G1> g_B = pk.B_query[0] + qap_wit.d2 * pk.B_query[variables + 1]
+    + knowledge_commitment<G2, G1>(
+        fixedBaseMultiExp(prepared.B_g, 0, B_scalars.data(), B_scalars.size()),
+        fixedBaseMultiExp(prepared.B_h, 0, B_scalars.data(), B_scalars.size()));
+  knowledge_commitment<G1, G1> g_C = pk.C_query[0] + qap_wit.d3 * pk.C_query[variables + 1]
+    + knowledge_commitment<G1, G1>(
+        fixedBaseMultiExp(prepared.C_g, 0, C_scalars.data(), C_scalars.size()),
+        fixedBaseMultiExp(prepared.C_h, 0, C_scalars.data(), C_scalars.size()));
+  G1 g_H = fixedBaseMultiExp(prepared.H_query, 0, qap_wit.coefficients_for_H.data(), qap_wit.degree() + 1);
+  G1 g_K = pk.K_query[0]
+    + qap_wit.d1 * pk.K_query[variables + 1]
+    + qap_wit.d2 * pk.K_query[variables + 2]
+    + qap_wit.d3 * pk.K_query[variables + 3]
+    + fixedBaseMultiExp(prepared.K_query, 1, coefficients.data(), variables);
+  libff::leave_block("Compute the proof");
+
+  return r1cs_ppzksnark_proof<ppT>(std::move(g_A), std::move(g_B), std::move(g_C), std::move(g_H), std::move(g_K));
+}
 
+// proves with the prepared tables when given some, with libsnark's prover otherwise
+template<typename ppT>
+r1cs_ppzksnark_proof<ppT> prove(const r1cs_ppzksnark_proving_key<ppT>& pk, const prepared_proving_key<ppT>* prepared, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input)
+{
+  if (prepared != nullptr)
+    return proveWithTables<ppT>(pk, *prepared, primary_input, auxiliary_input);
+  return r1cs_ppzksnark_prover<ppT>(pk, primary_input, auxiliary_input);
+}
+
+template<mp_size_t Q, typename ppT, typename G1T, typename G2T>
+std::string verificationKeyText(const r1cs_ppzksnark_verification_key<ppT>& vk) {
   unsigned icLength = vk.encoded_IC_query.rest.indices.size() + 1;
 
-  ss << "\t\tvk.A = " << outputPointG2AffineAsHex<Q, G2T>(vk.alphaA_g2) << endl;
-  ss << "\t\tvk.B = " << outputPointG1AffineAsHex<Q, G1T>(vk.alphaB_g1) << endl;
-  ss << "\t\tvk.C = " << outputPointG2AffineAsHex<Q, G2T>(vk.alphaC_g2) << endl;
-  ss << "\t\tvk.gamma = " << outputPointG2AffineAsHex<Q, G2T>(vk.gamma_g2) << endl;
-  ss << "\t\tvk.gammaBeta1 = " << outputPointG1AffineAsHex<Q, G1T>(vk.gamma_beta_g1) << endl;
-  ss << "\t\tvk.gammaBeta2 = " << outputPointG2AffineAsHex<Q, G2T>(vk.gamma_beta_g2) << endl;
-  ss << "\t\tvk.Z = " << outputPointG2AffineAsHex<Q, G2T>(vk.rC_Z_g2) << endl;
-  ss << "\t\tvk.IC.len() = " << icLength << endl;
-  ss << "\t\tvk.IC[0] = " << outputPointG1AffineAsHex<Q, G1T>(vk.encoded_IC_query.first) << endl;
+  // one line per G2 point, G1 point and IC entry
+  text_buffer out((icLength + 8) * (32 + 4 * hexLength<Q>()));
+
+  out << "\t\tvk.A = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.alphaA_g2, false); out << "\n";
+  out << "\t\tvk.B = "; appendPointG1AffineAsHex<Q, G1T>(out, vk.alphaB_g1, false); out << "\n";
+  out << "\t\tvk.C = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.alphaC_g2, false); out << "\n";
+  out << "\t\tvk.gamma = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.gamma_g2, false); out << "\n";
+  out << "\t\tvk.gammaBeta1 = "; appendPointG1AffineAsHex<Q, G1T>(out, vk.gamma_beta_g1, false); out << "\n";
+  out << "\t\tvk.gammaBeta2 = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.gamma_beta_g2, false); out << "\n";
+  out << "\t\tvk.Z = "; appendPointG2AffineAsHex<Q, G2T>(out, vk.rC_Z_g2, false); out << "\n";
+  out << "\t\tvk.IC.len() = " << icLength << "\n";
+  out << "\t\tvk.IC[0] = "; appendPointG1AffineAsHex<Q, G1T>(out, vk.encoded_IC_query.first, false); out << "\n";
   for (size_t i = 1; i < icLength; ++i)
   {
-                  auto vkICi = outputPointG1AffineAsHex<Q, G1T>(vk.encoded_IC_query.rest.values[i - 1]);
-                  ss << "\t\tvk.IC[" << i << "] = " << vkICi << endl;
+    out << "\t\tvk.IC[" << i << "] = ";
+    appendPointG1AffineAsHex<Q, G1T>(out, vk.encoded_IC_query.rest.values[i - 1], false);
+    out << "\n";
   }
 
-  std::ofstream fh;
-  fh.open(vk_path, std::ios::binary);
-  ss.rdbuf()->pubseekpos(0, std::ios_base::out);
-  fh << ss.rdbuf();
-  fh.flush();
-  fh.close();
+  return out.take();
 }
 
 template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
-void exportProof(r1cs_ppzksnark_proof<ppT> proof, const char* proof_path, const r1cs_primary_input<libff::Fr<ppT>> input) {
+std::string proofJson(const r1cs_ppzksnark_proof<ppT>& proof, const r1cs_primary_input<libff::Fr<ppT>>& input) {
   //create JSON file
-  std::stringstream ss;
-  ss << "{" << "\n";
-  ss << "\t\"proof\":" << "\n";
-  ss << "\t{" << "\n";
-  ss << "\t\t\"A\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.g_A.g) << ",\n";
-  ss << "\t\t\"A_p\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.g_A.h) << ",\n";
-  ss << "\t\t\"B\":" << "\n";
-  ss << "\t\t\t" << outputPointG2AffineAsHexJson<Q, G2T>(proof.g_B.g) << ",\n";
-  ss << "\t\t\n";
-  ss << "\t\t\"B_p\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.g_B.h) << ",\n";
-  ss << "\t\t\"C\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.g_C.g) << ",\n";
-  ss << "\t\t\"C_p\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.g_C.h) << ",\n";
-  ss << "\t\t\"H\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.g_H) << ",\n";
-  ss << "\t\t\"K\":" <<outputPointG1AffineAsHexJson<Q, G1T>(proof.g_K) << "\n";
-  ss << "\t}," << "\n";
+  text_buffer out(256 + 12 * hexLength<Q>() + input.size() * (hexLength<R>() + 3));
+  out << "{" << "\n";
+  out << "\t\"proof\":" << "\n";
+  out << "\t{" << "\n";
+  out << "\t\t\"A\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.g_A.g, true); out << ",\n";
+  out << "\t\t\"A_p\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.g_A.h, true); out << ",\n";
+  out << "\t\t\"B\":" << "\n";
+  out << "\t\t\t"; appendPointG2AffineAsHex<Q, G2T>(out, proof.g_B.g, true); out << ",\n";
+  out << "\t\t\n";
+  out << "\t\t\"B_p\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.g_B.h, true); out << ",\n";
+  out << "\t\t\"C\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.g_C.g, true); out << ",\n";
+  out << "\t\t\"C_p\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.g_C.h, true); out << ",\n";
+  out << "\t\t\"H\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.g_H, true); out << ",\n";
+  out << "\t\t\"K\":"; appendPointG1AffineAsHex<Q, G1T>(out, proof.g_K, true); out << "\n";
+  out << "\t}," << "\n";
   //add input to json
-  ss << "\t\"input\":" << "[";
+  out << "\t\"input\":" << "[";
   for (unsigned int i = 0; i < input.size(); i++) {
     if(i!=0){
-      ss << ",";
+      out << ",";
     }
-    ss << outputInputAsHex<R>(input[i].as_bigint());
+    out << "\""; out.hex<R>(input[i].as_bigint()); out << "\"";
   }
-  ss << "]" << "\n";
-  ss << "}" << "\n";
-  std::string s = ss.str();
-  //write json string to proof_path
-  writeToFile(proof_path, s);
+  out << "]" << "\n";
+  out << "}" << "\n";
+  return out.take();
+}
+
+// `out` is a path or a vk_bytes, see storeVerificationKey
+template<mp_size_t Q, typename ppT, typename G1T, typename G2T, typename VkOut>
+bool exportVerificationKey(const r1cs_ppzksnark_verification_key<ppT>& vk, VkOut& out)
+{
+  // vk in raw format (easy verify)
+  return storeVerificationKey(verificationKeyText<Q, ppT, G1T, G2T>(vk), vk, out);
 }
 
 template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
-bool setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+void exportProof(const r1cs_ppzksnark_proof<ppT>& proof, const r1cs_primary_input<libff::Fr<ppT>>& input, proof_bytes& out)
 {
-  auto cs = createConstraintSystem<R, ppT>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs);
-  assert(cs.num_variables() >= (unsigned)inputs);
-  assert(cs.num_inputs() == (unsigned)inputs);
-  assert(cs.num_constraints() == (unsigned)constraints);
+  out.json = proofJson<Q, R, ppT, G1T, G2T>(proof, input);
+  // proof and primary input in raw format (easy verify)
+  out.raw = serializeToString(proof);
+  out.input = serializeVectorToString(input);
+}
+
+// `cs` is released once the keys are generated, the proving key holding its own copy
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T, typename VkOut>
+bool setup(r1cs_ppzksnark_constraint_system<ppT>& cs, binary_writer& pk, VkOut& vk)
+{
+  profile_phase generation("key_generation");
   auto keypair = r1cs_ppzksnark_generator<ppT>(cs);
+  cs = r1cs_ppzksnark_constraint_system<ppT>();
+  releaseFreeMemory();
+  generation.end();
+
+  if (binaryFormatFlagsFromEnv() & BINARY_FORMAT_SPARSE_QUERIES)
+    printPruningStats<ppT>(keypair.pk);
+  profile_phase serialization("key_serialization");
+  if (!exportVerificationKey<Q, ppT, G1T, G2T>(keypair.vk, vk))
+    return false;
+  serializeProvingKey<ppT>(pk, keypair.pk);
+  return true;
+}
+
+// writes the keys to pk_path, vk_path and vk_path.raw, and stores them as `entry`, see
+// setup_cache.tcc. The previous keys stay in place until the new ones are complete.
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(r1cs_ppzksnark_constraint_system<ppT>& cs, const char* pk_path, const char* vk_path, const std::string& entry)
+{
+  const setup_outputs tmp = temporarySetupOutputs(pk_path, vk_path);
+  const setup_outputs outputs(pk_path, vk_path);
+  const char* tmp_vk_path = tmp.vk.c_str();
+  binary_writer pk(tmp.pk);
+  if (!setup<Q, R, ppT, G1T, G2T>(cs, pk, tmp_vk_path) || !pk.close() || !replaceSetupOutputs(tmp, outputs)) {
+    removeSetupOutputs(tmp);
+    return false;
+  }
+  storeSetupKeys(entry, outputs);
+  return true;
+}
 
-  serializeProvingKeyToFile<ppT>(keypair.pk, pk_path);
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(r1cs_ppzksnark_constraint_system<ppT>& cs, buffer* pk_out, vk_buffers* vk_out)
+{
+  std::string pk_bytes;
+  binary_writer pk(&pk_bytes);
+  vk_bytes vk;
+  if (!setup<Q, R, ppT, G1T, G2T>(cs, pk, vk) || !toBuffer(pk_bytes, pk_out))
+    return false;
+  if (toBuffers(vk, vk_out))
+    return true;
+  _free_buffer(pk_out);
+  return false;
+}
 
-  serializeVerificationKeyToFile<Q, ppT, G1T, G2T>(keypair.vk, vk_path);
-  // serialize vk in raw format (easy verify)
-  string raw_vk_path = string(vk_path).append(".raw");
-  writeToFile(raw_vk_path, keypair.vk);
+// the stored keys of the same rows when there are some, copied to pk_path, vk_path and
+// vk_path.raw before any constraint system is built
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+{
+  const std::string entry = setupKeysEntry<ppT>(BINARY_FORMAT_PGHR13, [&] {
+    return r1cs_builder<R, libff::Fr<ppT>>::rowsDigest(A, B, C, A_len, B_len, C_len, constraints, variables, inputs);
+  });
+  if (restoreSetupKeys(entry, pk_path, vk_path))
+    return true;
+  r1cs_ppzksnark_constraint_system<ppT> cs;
+  return createConstraintSystem<R, ppT>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, cs)
+    && setup<Q, R, ppT, G1T, G2T>(cs, pk_path, vk_path, entry);
+}
 
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, buffer* pk, vk_buffers* vk)
+{
+  r1cs_ppzksnark_constraint_system<ppT> cs;
+  return createConstraintSystem<R, ppT>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, cs)
+    && setup<Q, R, ppT, G1T, G2T>(cs, pk, vk);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool setup(constraint_chunk_callback next_chunk, void* state, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+{
+  profile_phase building("constraint_building");
+  r1cs_ppzksnark_constraint_system<ppT> cs;
+  if (!streamConstraintSystem<R, libff::Fr<ppT>>(next_chunk, state, constraints, variables, inputs, cs))
+    return false;
+  building.end();
+  // the rows are gone by now, so the store goes by the built constraint system
+  const std::string entry = setupKeysEntry<ppT>(BINARY_FORMAT_PGHR13, [&] { return constraintSystemDigest(cs); });
+  if (restoreSetupKeys(entry, pk_path, vk_path))
+    return true;
+  return setup<Q, R, ppT, G1T, G2T>(cs, pk_path, vk_path, entry);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const r1cs_ppzksnark_proving_key<ppT>& pk, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input, proof_bytes& out, const prepared_proving_key<ppT>* prepared = nullptr)
+{
+  profile_phase proving("prove");
+  auto proof = prove<ppT>(pk, prepared, primary_input, auxiliary_input);
+  proving.end();
+
+  profile_phase exporting("proof_export");
+  exportProof<Q, R, ppT, G1T, G2T>(proof, primary_input, out);
   return true;
 }
 
+// writes the proof to proof_path, proof_path.raw and proof_path.input.raw
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const r1cs_ppzksnark_proving_key<ppT>& pk, const char* proof_path, const r1cs_primary_input<libff::Fr<ppT>>& primary_input, const r1cs_auxiliary_input<libff::Fr<ppT>>& auxiliary_input, const prepared_proving_key<ppT>* prepared = nullptr)
+{
+  proof_bytes proof;
+  return generate_proof<Q, R, ppT, G1T, G2T>(pk, primary_input, auxiliary_input, proof, prepared) && writeProofFiles(proof, proof_path);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const r1cs_ppzksnark_proving_key<ppT>& pk, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, const prepared_proving_key<ppT>* prepared = nullptr)
+{
+  r1cs_primary_input<libff::Fr<ppT>> primary_input;
+  r1cs_auxiliary_input<libff::Fr<ppT>> auxiliary_input;
+  profile_phase marshalling("witness_marshalling");
+  witnessFromBytes<R>(public_inputs, public_inputs_length, private_inputs, private_inputs_length, primary_input, auxiliary_input);
+  marshalling.end();
+  return generate_proof<Q, R, ppT, G1T, G2T>(pk, proof_path, primary_input, auxiliary_input, prepared);
+}
+
 template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
 bool generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length)
 {
-  auto pk = deserializeProvingKeyFromFile<ppT>(pk_path);
-  r1cs_variable_assignment<libff::Fr<ppT> > full_variable_assignment;
-  for (int i = 1; i < public_inputs_length; i++) {
-    full_variable_assignment.push_back(libff::Fr<ppT>(libsnarkBigintFromBytes<R>(public_inputs + i*R*mp_limb_t_size)));
+  profile_phase deserialization("key_deserialization");
+  r1cs_ppzksnark_proving_key<ppT> pk;
+  if (!deserializeProvingKeyFromFile<ppT>(pk_path, pk))
+    return false;
+  prepared_proving_key<ppT> prepared;
+  const bool has_prepared = loadPreparedProvingKey<ppT>(pk_path, prepared);
+  deserialization.end();
+  return generate_proof<Q, R, ppT, G1T, G2T>(pk, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length, has_prepared ? &prepared : nullptr);
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const char* pk_path, const char* proof_path, uint64_t* witness, int public_inputs_length, int variables)
+{
+  profile_phase deserialization("key_deserialization");
+  r1cs_ppzksnark_proving_key<ppT> pk;
+  if (!deserializeProvingKeyFromFile<ppT>(pk_path, pk))
+    return false;
+  prepared_proving_key<ppT> prepared;
+  const bool has_prepared = loadPreparedProvingKey<ppT>(pk_path, prepared);
+  deserialization.end();
+  r1cs_primary_input<libff::Fr<ppT>> primary_input;
+  r1cs_auxiliary_input<libff::Fr<ppT>> auxiliary_input;
+  profile_phase marshalling("witness_marshalling");
+  witnessFromLimbs<R>(witness, public_inputs_length, variables, primary_input, auxiliary_input);
+  marshalling.end();
+  return generate_proof<Q, R, ppT, G1T, G2T>(pk, proof_path, primary_input, auxiliary_input, has_prepared ? &prepared : nullptr);
+}
+
+// proves every witness against one key, loaded once, writing proof i to proof_paths[i];
+// results[i] tells whether it was written. Witnesses are laid out as for the limbs prover
+// above, and are proven concurrently in multicore builds.
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proofs(const char* pk_path, const char* const* proof_paths, uint64_t* const* witnesses, int count, int public_inputs_length, int variables, bool* results)
+{
+  std::fill(results, results + count, false);
+  profile_phase deserialization("key_deserialization");
+  r1cs_ppzksnark_proving_key<ppT> pk;
+  if (!deserializeProvingKeyFromFile<ppT>(pk_path, pk))
+    return false;
+  prepared_proving_key<ppT> prepared;
+  const bool has_prepared = loadPreparedProvingKey<ppT>(pk_path, prepared);
+  deserialization.end();
+
+  std::vector<r1cs_primary_input<libff::Fr<ppT>>> primary_inputs(count);
+  std::vector<r1cs_auxiliary_input<libff::Fr<ppT>>> auxiliary_inputs(count);
+  profile_phase marshalling("witness_marshalling");
+  for (int i = 0; i < count; i++)
+    witnessFromLimbs<R>(witnesses[i], public_inputs_length, variables, primary_inputs[i], auxiliary_inputs[i]);
+  marshalling.end();
+
+  profile_phase proving("prove");
+  std::vector<r1cs_ppzksnark_proof<ppT>> proofs(count);
+  {
+    libff_timers_paused paused;
+    forEachProof(count, [&](int i) {
+      proofs[i] = prove<ppT>(pk, has_prepared ? &prepared : nullptr, primary_inputs[i], auxiliary_inputs[i]);
+    });
   }
-  for (int i = 0; i < private_inputs_length; i++) {
-    full_variable_assignment.push_back(libff::Fr<ppT>(libsnarkBigintFromBytes<R>(private_inputs + i*R*mp_limb_t_size)));
+  proving.end();
+
+  profile_phase exporting("proof_export");
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < count; i++) {
+    proof_bytes proof;
+    exportProof<Q, R, ppT, G1T, G2T>(proofs[i], primary_inputs[i], proof);
+    results[i] = writeProofFiles(proof, proof_paths[i]);
   }
-  r1cs_primary_input<libff::Fr<ppT>> primary_input(full_variable_assignment.begin(), full_variable_assignment.begin() + public_inputs_length-1);
-  r1cs_auxiliary_input<libff::Fr<ppT>> auxiliary_input(full_variable_assignment.begin() + public_inputs_length-1, full_variable_assignment.end());
-  auto proof = r1cs_ppzksnark_prover<ppT>(pk, primary_input, auxiliary_input);
-
-  exportProof<Q, R, ppT, G1T, G2T>(proof, proof_path, primary_input);
-  // serialize proof in raw format (easy verify)
-  string raw_proof_path = string(proof_path).append(".raw");
-  writeToFile(raw_proof_path, proof);
-  // serialize primary input in raw format (easy verify)
-  string raw_input_path = string(proof_path).append(".input.raw");
-  writeVectorToFile(raw_input_path, primary_input);
+  return std::all_of(results, results + count, [](bool ok) { return ok; });
+}
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+bool generate_proof(const byte_range& pk_bytes, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, proof_buffers* out)
+{
+  profile_phase deserialization("key_deserialization");
+  r1cs_ppzksnark_proving_key<ppT> pk;
+  if (!deserializeProvingKey<ppT>(pk_bytes, pk))
+    return false;
+  deserialization.end();
+  r1cs_primary_input<libff::Fr<ppT>> primary_input;
+  r1cs_auxiliary_input<libff::Fr<ppT>> auxiliary_input;
+  profile_phase marshalling("witness_marshalling");
+  witnessFromBytes<R>(public_inputs, public_inputs_length, private_inputs, private_inputs_length, primary_input, auxiliary_input);
+  marshalling.end();
+  proof_bytes proof;
+  return generate_proof<Q, R, ppT, G1T, G2T>(pk, primary_input, auxiliary_input, proof) && toBuffers(proof, out);
+}
 
+// long-lived prover: curve parameters are initialised once and proving keys stay loaded between proofs
+class context {
+  public:
+    virtual ~context() {}
+    virtual bool generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length) = 0;
+};
+
+template<mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
+class curve_context : public context {
+  public:
+    curve_context() : keys(deserializeProvingKeyFromFile<ppT>), prepared_keys(readPreparedProvingKey<ppT>)
+    {
+      libff::inhibit_profiling_info = true;
+      libff::inhibit_profiling_counters = true;
+      ppT::init_public_params();
+    }
+
+    bool generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length) override
+    {
+      profile_phase deserialization("key_deserialization");
+      std::string key_digest;
+      auto pk = keys.get(pk_path, &key_digest);
+      if (!pk)
+        return false;
+      auto prepared = prepared_keys.get(preparedKeyPath(pk_path).c_str());
+      if (prepared && prepared->key_source.digest != key_digest)
+        prepared = nullptr;
+      deserialization.end();
+      return pghr13::generate_proof<Q, R, ppT, G1T, G2T>(*pk, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length, prepared.get());
+    }
+
+  private:
+    key_cache<r1cs_ppzksnark_proving_key<ppT>> keys;
+    key_cache<prepared_proving_key<ppT>> prepared_keys;
+};
+
+// proofs without bytes are not loaded
+template<typename ppT>
+bool parseProof(const proof_range& bytes, r1cs_ppzksnark_proof<ppT>& proof, r1cs_primary_input<libff::Fr<ppT>>& input)
+{
+  if (bytes.raw.data == nullptr || bytes.input.data == nullptr)
+    return false;
+  proof = deserializeFromRange<r1cs_ppzksnark_proof<ppT>>(bytes.raw);
+  input = deserializeVectorFromRange<libff::Fr<ppT>>(bytes.input);
   return true;
 }
 
+// Checks all the proofs at once: each of the five pairing equations of each proof is raised to
+// an independent random power and everything is multiplied together, which holds for every
+// choice of powers only if each equation does. Powers are applied to the G1 sides, terms sharing
+// a vk G2 element are summed before their Miller loop, and the three terms pairing with a
+// proof's B share one, so n proofs cost n + 6 Miller loops and a single final exponentiation.
 template<typename ppT>
-bool verify_proof(const char* vk_path, const char* proof_path)
+bool batchCheck(const r1cs_ppzksnark_verification_key<ppT>& vk, const r1cs_ppzksnark_processed_verification_key<ppT>& pvk,
+    const std::vector<r1cs_ppzksnark_proof<ppT>>& proofs, const std::vector<r1cs_primary_input<libff::Fr<ppT>>>& inputs)
 {
-  string raw_vk_path = string(vk_path).append(".raw");
-  auto vk = loadFromFile<r1cs_ppzksnark_verification_key<ppT>>(raw_vk_path);
+  typedef libff::G1<ppT> G1;
+  typedef libff::Fr<ppT> Fr;
+
+  const size_t count = proofs.size();
+  for (size_t i = 0; i < count; i++) {
+    if (inputs[i].size() != pvk.encoded_IC_query.domain_size() || !proofs[i].is_well_formed())
+      return false;
+  }
+
+  // r[i][j]: power of equation j (A, B, C, QAP, K) of proof i
+  std::vector<std::array<Fr, 5>> r(count);
+  for (size_t i = 0; i < count; i++)
+    for (Fr& x : r[i])
+      x = Fr::random_element();
 
-  string raw_proof_path = string(proof_path).append(".raw");
-  auto proof = loadFromFile<r1cs_ppzksnark_proof<ppT>>(raw_proof_path);
+  // G1 sums paired with g2, alphaA_g2, alphaC_g2, rC_Z_g2, gamma_g2 and gamma_beta_g2
+  enum { ONE, ALPHA_A, ALPHA_C, RC_Z, GAMMA, GAMMA_BETA, SHARED };
+  std::vector<std::array<G1, SHARED>> shared(count);
+  std::vector<libff::Fqk<ppT>> b_loops(count);
 
-  string raw_input_path = string(proof_path).append(".input.raw");
-  auto input = loadVectorFromFile<libff::Fr<ppT>>(raw_input_path);
+  libff_timers_paused paused;
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for (size_t i = 0; i < count; i++) {
+    const r1cs_ppzksnark_proof<ppT>& proof = proofs[i];
+    const Fr& r_A = r[i][0];
+    const Fr& r_B = r[i][1];
+    const Fr& r_C = r[i][2];
+    const Fr& r_QAP = r[i][3];
+    const Fr& r_K = r[i][4];
 
-  return r1cs_ppzksnark_verifier_strong_IC<ppT>(vk, input, proof);
+    const G1 acc = pvk.encoded_IC_query.template accumulate_chunk<Fr>(inputs[i].begin(), inputs[i].end(), 0).first;
+    const G1 acc_A = acc + proof.g_A.g;
+
+    shared[i][ONE] = -(r_A * proof.g_A.h + r_B * proof.g_B.h + r_C * proof.g_C.h + r_QAP * proof.g_C.g);
+    shared[i][ALPHA_A] = r_A * proof.g_A.g;
+    shared[i][ALPHA_C] = r_C * proof.g_C.g;
+    shared[i][RC_Z] = -(r_QAP * proof.g_H);
+    shared[i][GAMMA] = r_K * proof.g_K;
+    shared[i][GAMMA_BETA] = -(r_K * (acc_A + proof.g_C.g));
+
+    const G1 b_side = r_B * vk.alphaB_g1 + r_QAP * acc_A - r_K * vk.gamma_beta_g1;
+    b_loops[i] = ppT::miller_loop(ppT::precompute_G1(b_side), ppT::precompute_G2(proof.g_B.g));
+  }
+
+  std::array<G1, SHARED> sums;
+  sums.fill(G1::zero());
+  libff::Fqk<ppT> product = libff::Fqk<ppT>::one();
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = 0; j < SHARED; j++)
+      sums[j] = sums[j] + shared[i][j];
+    product = product * b_loops[i];
+  }
+
+  const libff::G2_precomp<ppT>* g2_precomps[SHARED] = {
+    &pvk.pp_G2_one_precomp, &pvk.vk_alphaA_g2_precomp, &pvk.vk_alphaC_g2_precomp,
+    &pvk.vk_rC_Z_g2_precomp, &pvk.vk_gamma_g2_precomp, &pvk.vk_gamma_beta_g2_precomp,
+  };
+  for (size_t j = 0; j < SHARED; j++) {
+    if (!sums[j].is_zero())
+      product = product * ppT::miller_loop(ppT::precompute_G1(sums[j]), *g2_precomps[j]);
+  }
+
+  return ppT::final_exponentiation(product) == libff::GT<ppT>::one();
 }
 
-template<typename ppT_F, mp_size_t Q, mp_size_t R, typename ppT, typename G1T, typename G2T>
-bool batch(
-    const char *vk_1_path, const char *proof_1_path,
-    const char *vk_2_path, const char *proof_2_path,
-    const char *agg_vk_path, const char *agg_proof_path)
+// verifies every proof against one vk, loaded and processed once; results[i] tells whether
+// proof i holds. A batch check covers the common all-valid case, and proofs are only checked
+// one by one, in parallel, to find out which ones fail.
+template<typename ppT>
+bool verify_proofs(const byte_range& vk_raw, const proof_range* proof_data, int count, bool* results)
 {
-  // vks
-  std::vector<r1cs_ppzksnark_verification_key<ppT_F>> vks;
-  {
-    string raw_vk_path = string(vk_1_path).append(".raw");
-    auto vk = loadFromFile<r1cs_ppzksnark_verification_key<ppT_F>>(raw_vk_path);
-    vks.emplace_back(vk);
+  profile_phase loading("key_deserialization");
+  auto vk = deserializeFromRange<r1cs_ppzksnark_verification_key<ppT>>(vk_raw);
+  auto pvk = r1cs_ppzksnark_verifier_process_vk<ppT>(vk);
+
+  std::vector<r1cs_ppzksnark_proof<ppT>> proofs(count);
+  std::vector<r1cs_primary_input<libff::Fr<ppT>>> inputs(count);
+  bool loaded = true;
+  for (int i = 0; i < count; i++) {
+    results[i] = parseProof<ppT>(proof_data[i], proofs[i], inputs[i]);
+    loaded = loaded && results[i];
   }
-  {
-    string raw_vk_path = string(vk_2_path).append(".raw");
-    auto vk = loadFromFile<r1cs_ppzksnark_verification_key<ppT_F>>(raw_vk_path);
-    vks.emplace_back(vk);
+
+  loading.end();
+
+  profile_phase verification("verification");
+  if (loaded && batchCheck<ppT>(vk, pvk, proofs, inputs))
+    return true;
+
+  libff_timers_paused paused;
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < count; i++)
+    results[i] = results[i] && r1cs_ppzksnark_online_verifier_strong_IC<ppT>(pvk, inputs[i], proofs[i]);
+
+  return std::all_of(results, results + count, [](bool ok) { return ok; });
+}
+
+// reads the raw vk and proofs next to the given paths
+template<typename ppT>
+bool verify_proofs(const char* vk_path, const char* const* proof_paths, int count, bool* results)
+{
+  string vk_raw;
+  if (!readVerificationKeyFile(vk_path, vk_raw)) {
+    std::fill(results, results + count, false);
+    return false;
   }
+  std::vector<string> storage;
+  std::vector<proof_range> proofs = readProofs(proof_paths, count, storage);
+  return verify_proofs<ppT>(rangeOf(vk_raw), proofs.data(), count, results);
+}
 
-  // inputs
-  std::vector<r1cs_primary_input<libff::Fr<ppT_F>>> inputs;
-  {
-    string raw_input_path = string(proof_1_path).append(".input.raw");
-    auto input = loadVectorFromFile<libff::Fr<ppT_F>>(raw_input_path);
-    inputs.emplace_back(input);
+template<typename ppT>
+bool verify_proof(const char* vk_path, const char* proof_path)
+{
+  bool result;
+  return verify_proofs<ppT>(vk_path, &proof_path, 1, &result);
+}
+
+// curve parameters needed to export a proof aggregated on ppT
+template<typename ppT> struct aggregation_curve;
+template<> struct aggregation_curve<libff::mnt4_pp> {
+  static const char* name() { return "mnt4"; }
+  static const mp_size_t Q = libff::mnt4_q_limbs;
+  static const mp_size_t R = libff::mnt4_r_limbs;
+  typedef libff::mnt4_G1 G1T;
+  typedef libff::mnt4_G2 G2T;
+};
+template<> struct aggregation_curve<libff::mnt6_pp> {
+  static const char* name() { return "mnt6"; }
+  static const mp_size_t Q = libff::mnt6_q_limbs;
+  static const mp_size_t R = libff::mnt6_r_limbs;
+  typedef libff::mnt6_G1 G1T;
+  typedef libff::mnt6_G2 G2T;
+};
+
+// proofs waiting to be aggregated, with the key and inputs each one verifies against
+template<typename ppT>
+struct aggregation_instances {
+  std::vector<r1cs_ppzksnark_verification_key<ppT>> vks;
+  std::vector<r1cs_primary_input<libff::Fr<ppT>>> inputs;
+  std::vector<r1cs_ppzksnark_proof<ppT>> proofs;
+};
+
+template<typename ppT>
+bool loadAggregationInstances(const byte_range* vks, const proof_range* proofs, int count, aggregation_instances<ppT>& instances)
+{
+  instances.vks.resize(count);
+  instances.inputs.resize(count);
+  instances.proofs.resize(count);
+  for (int i = 0; i < count; i++) {
+    if (vks[i].data == nullptr || !parseProof<ppT>(proofs[i], instances.proofs[i], instances.inputs[i])) {
+      cerr << "missing raw verification key, proof or input for proof " << i << endl;
+      return false;
+    }
+    instances.vks[i] = deserializeFromRange<r1cs_ppzksnark_verification_key<ppT>>(vks[i]);
+    if (instances.inputs[i].size() != instances.inputs[0].size()) {
+      cerr << "all aggregated proofs must have the same number of inputs" << endl;
+      return false;
+    }
   }
-  {
-    string raw_input_path = string(proof_2_path).append(".input.raw");
-    auto input = loadVectorFromFile<libff::Fr<ppT_F>>(raw_input_path);
-    inputs.emplace_back(input);
+  return true;
+}
+
+// aggregator keys are cached in $ZOKRATES_AGGREGATOR_KEYS, or in ~/.zokrates/aggregator_keys
+// when it is unset; an empty value disables the cache
+string aggregatorKeysDirectory()
+{
+  const char* dir = getenv("ZOKRATES_AGGREGATOR_KEYS");
+  if (dir != nullptr)
+    return dir;
+  const char* home = getenv("HOME");
+  return home == nullptr ? "" : string(home).append("/.zokrates/aggregator_keys");
+}
+
+// the aggregator circuit only depends on the curves, the arity and the inputs count, so its
+// keypair is generated once and reused; the file name also carries the constraint system
+// digest so that a change to the circuit never picks up stale keys
+template<typename from, typename to>
+r1cs_ppzksnark_keypair<to> aggregationKeypair(size_t arity, size_t inputs_count)
+{
+  aggregator<from, to> circuit(arity, inputs_count);
+  circuit.generate_r1cs_constraints();
+  const r1cs_ppzksnark_constraint_system<to>& cs = circuit.pb.get_constraint_system();
+
+  string dir = aggregatorKeysDirectory();
+  if (dir.empty())
+    return r1cs_ppzksnark_generator<to>(cs);
+
+  stringstream name;
+  name << dir << "/" << aggregation_curve<from>::name() << "_" << aggregation_curve<to>::name()
+       << "_" << arity << "_" << inputs_count << "_" << constraintSystemDigest(cs);
+  string pk_path = name.str() + ".pk";
+  string vk_path = name.str() + ".vk";
+
+  r1cs_ppzksnark_proving_key<to> pk;
+  if (ifstream(vk_path).good() && deserializeProvingKeyFromFile<to>(pk_path.c_str(), pk)) {
+    auto vk = loadFromFile<r1cs_ppzksnark_verification_key<to>>(vk_path);
+    return r1cs_ppzksnark_keypair<to>(std::move(pk), std::move(vk));
   }
 
-  // proofs
-  std::vector<r1cs_ppzksnark_proof<ppT_F>> proofs;
-  {
-    string raw_proof_path = string(proof_1_path).append(".raw");
-    auto proof = loadFromFile<r1cs_ppzksnark_proof<ppT_F>>(raw_proof_path);
-    proofs.emplace_back(proof);
+  r1cs_ppzksnark_keypair<to> keypair = r1cs_ppzksnark_generator<to>(cs);
+
+  // write under temporary names and rename, so that concurrent batches never read a partial key
+  string suffix = ".tmp." + to_string(getpid());
+  bool cached = makeDirectories(dir) && serializeProvingKeyToFile<to>(keypair.pk, (pk_path + suffix).c_str());
+  if (cached) {
+    cached = writeToFile(vk_path + suffix, keypair.vk)
+      && rename((vk_path + suffix).c_str(), vk_path.c_str()) == 0
+      && rename((pk_path + suffix).c_str(), pk_path.c_str()) == 0;
   }
-  {
-    string raw_proof_path = string(proof_2_path).append(".raw");
-    auto proof = loadFromFile<r1cs_ppzksnark_proof<ppT_F>>(raw_proof_path);
-    proofs.emplace_back(proof);
+  if (!cached) {
+    cerr << "could not cache the aggregator keys in " << dir << endl;
+    remove((pk_path + suffix).c_str());
+    remove((vk_path + suffix).c_str());
   }
+  return keypair;
+}
 
-  aggregator<ppT_F, ppT> agg(2, inputs[0].size());
-  agg.generate_r1cs_constraints();
-  r1cs_ppzksnark_keypair<ppT> keypair = r1cs_ppzksnark_generator<ppT>(agg.pb.get_constraint_system());
-  agg.generate_r1cs_witness(vks, inputs, proofs);
-  auto primary_input = agg.pb.primary_input();
-  auto auxiliary_input = agg.pb.auxiliary_input();
-  r1cs_ppzksnark_proof<ppT> proof = r1cs_ppzksnark_prover<ppT>(keypair.pk, primary_input, auxiliary_input);
-
-  serializeVerificationKeyToFile<Q, ppT, G1T, G2T>(keypair.vk, agg_vk_path);
-  // serialize vk in raw format (easy verify)
-  string raw_agg_vk_path = string(agg_vk_path).append(".raw");
-  writeToFile(raw_agg_vk_path, keypair.vk);
-
-  exportProof<Q, R, ppT, G1T, G2T>(proof, agg_proof_path, primary_input);
-  // serialize proof in raw format (easy verify)
-  string raw_agg_proof_path = string(agg_proof_path).append(".raw");
-  writeToFile(raw_agg_proof_path, proof);
-  // serialize primary input in raw format (easy verify)
-  string raw_agg_input_path = string(agg_proof_path).append(".input.raw");
-  writeVectorToFile(raw_agg_input_path, primary_input);
+// folds every `arity` consecutive instances into one proof on the other curve, padding the
+// last group by repeating its last proof. All groups share one circuit, hence one keypair,
+// and are proven concurrently in multicore builds. Fails if the witness of a group does not
+// satisfy the aggregator circuit, which happens when one of its proofs does not verify.
+template<typename from, typename to>
+bool aggregateLayer(const aggregation_instances<from>& instances, size_t arity, aggregation_instances<to>& layer)
+{
+  const size_t count = instances.proofs.size();
+  const size_t inputs_count = instances.inputs[0].size();
+  const size_t groups = (count + arity - 1) / arity;
+
+  profile_phase keys("aggregator_keys");
+  r1cs_ppzksnark_keypair<to> keypair = aggregationKeypair<from, to>(arity, inputs_count);
+  keys.end();
+
+  layer.vks.assign(groups, keypair.vk);
+  layer.inputs.resize(groups);
+  layer.proofs.resize(groups);
+
+  profile_phase proving("aggregation_proving");
+  libff_timers_paused paused;
+  std::vector<char> satisfied(groups, false);
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(dynamic) if (groups > 1)
+#endif
+  for (size_t g = 0; g < groups; g++) {
+    std::vector<r1cs_ppzksnark_verification_key<from>> vks;
+    std::vector<r1cs_primary_input<libff::Fr<from>>> inputs;
+    std::vector<r1cs_ppzksnark_proof<from>> proofs;
+    for (size_t k = 0; k < arity; k++) {
+      size_t i = std::min(g * arity + k, count - 1);
+      vks.push_back(instances.vks[i]);
+      inputs.push_back(instances.inputs[i]);
+      proofs.push_back(instances.proofs[i]);
+    }
+
+    // the witness only touches variables allocated by the constructor, so the
+    // constraints generated above are not rebuilt for every group
+    aggregator<from, to> agg(arity, inputs_count);
+    agg.generate_r1cs_witness(vks, inputs, proofs);
+    layer.inputs[g] = agg.pb.primary_input();
+    const r1cs_auxiliary_input<libff::Fr<to>> auxiliary_input = agg.pb.auxiliary_input();
+    satisfied[g] = keypair.pk.constraint_system.is_satisfied(layer.inputs[g], auxiliary_input);
+    if (satisfied[g])
+      layer.proofs[g] = r1cs_ppzksnark_prover<to>(keypair.pk, layer.inputs[g], auxiliary_input);
+  }
 
+  for (size_t g = 0; g < groups; g++) {
+    if (!satisfied[g]) {
+      cerr << "aggregator circuit not satisfied by proofs " << g * arity << " to " << std::min((g + 1) * arity, count) - 1 << endl;
+      return false;
+    }
+  }
   return true;
 }
 
+template<typename ppT, typename VkOut>
+bool exportAggregate(aggregation_instances<ppT>& aggregate, VkOut& agg_vk, proof_bytes& agg_proof)
+{
+  typedef aggregation_curve<ppT> curve;
+
+  profile_phase exporting("proof_export");
+  exportProof<curve::Q, curve::R, ppT, typename curve::G1T, typename curve::G2T>(aggregate.proofs[0], aggregate.inputs[0], agg_proof);
+  return exportVerificationKey<curve::Q, ppT, typename curve::G1T, typename curve::G2T>(aggregate.vks[0], agg_vk);
+}
+
+// aggregates layer after layer, alternating curves, until a single proof is left
+template<typename from, typename to, typename VkOut>
+bool aggregateTree(const aggregation_instances<from>& instances, size_t arity, VkOut& agg_vk, proof_bytes& agg_proof)
+{
+  aggregation_instances<to> layer;
+  if (!aggregateLayer<from, to>(instances, arity, layer))
+    return false;
+  if (layer.proofs.size() == 1)
+    return exportAggregate<to>(layer, agg_vk, agg_proof);
+  return aggregateTree<to, from>(layer, arity, agg_vk, agg_proof);
+}
+
+// `agg_vk` is a path or a vk_bytes, see storeVerificationKey
+template<typename ppT_F, typename ppT, typename VkOut>
+bool batch(const byte_range* vks, const proof_range* proofs, int count, int arity, VkOut& agg_vk, proof_bytes& agg_proof)
+{
+  if (count < 1 || arity < 1 || (arity == 1 && count > 1)) {
+    cerr << "cannot aggregate " << count << " proofs with arity " << arity << endl;
+    return false;
+  }
+
+  profile_phase loading("proof_loading");
+  aggregation_instances<ppT_F> instances;
+  if (!loadAggregationInstances<ppT_F>(vks, proofs, count, instances))
+    return false;
+  loading.end();
+
+  return aggregateTree<ppT_F, ppT>(instances, arity, agg_vk, agg_proof);
+}
+
+// reads the raw vks and proofs next to the given paths and writes the aggregate next to
+// agg_vk_path and agg_proof_path
+template<typename ppT_F, typename ppT>
+bool batch(const char* const* vk_paths, const char* const* proof_paths, int count, int arity, const char* agg_vk_path, const char* agg_proof_path)
+{
+  std::vector<string> vk_storage(std::max(count, 0));
+  std::vector<byte_range> vks(std::max(count, 0));
+  for (int i = 0; i < count; i++) {
+    if (readVerificationKeyFile(vk_paths[i], vk_storage[i]))
+      vks[i] = rangeOf(vk_storage[i]);
+  }
+  std::vector<string> proof_storage;
+  std::vector<proof_range> proofs = readProofs(proof_paths, std::max(count, 0), proof_storage);
+
+  proof_bytes agg_proof;
+  return batch<ppT_F, ppT>(vks.data(), proofs.data(), count, arity, agg_vk_path, agg_proof)
+    && writeProofFiles(agg_proof, agg_proof_path);
+}
+
+template<typename ppT_F, typename ppT>
+bool batch(const byte_range* vks, const proof_range* proofs, int count, int arity, vk_buffers* agg_vk_out, proof_buffers* agg_proof_out)
+{
+  vk_bytes agg_vk;
+  proof_bytes agg_proof;
+  if (!batch<ppT_F, ppT>(vks, proofs, count, arity, agg_vk, agg_proof) || !toBuffers(agg_vk, agg_vk_out))
+    return false;
+  if (toBuffers(agg_proof, agg_proof_out))
+    return true;
+  _free_buffer(&agg_vk_out->text);
+  _free_buffer(&agg_vk_out->raw);
+  return false;
 }
 
-bool _pghr13_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+}
+
+bool _pghr13_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
 {
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_setup");
   return pghr13::setup<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk_path, vk_path);
 }
 
-bool _pghr13_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length)
+bool _pghr13_setup_streamed(constraint_chunk_callback next_chunk, void* state, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
 {
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_setup_streamed");
+  return pghr13::setup<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(next_chunk, state, constraints, variables, inputs, pk_path, vk_path);
+}
+
+bool _pghr13_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_generate_proof");
   return pghr13::generate_proof<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk_path, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length);
 }
 
+bool _pghr13_generate_proof_limbs(const char* pk_path, const char* proof_path, uint64_t* witness, int public_inputs_length, int variables, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_generate_proof_limbs");
+  return pghr13::generate_proof<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk_path, proof_path, witness, public_inputs_length, variables);
+}
+
+bool _pghr13_generate_proofs_limbs(const char* pk_path, const char* const* proof_paths, uint64_t* const* witnesses, int count, int public_inputs_length, int variables, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_generate_proofs_limbs");
+  return pghr13::generate_proofs<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk_path, proof_paths, witnesses, count, public_inputs_length, variables, results);
+}
+
 bool _pghr13_verify_proof(const char* vk_path, const char* proof_path)
 {
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_verify_proof");
   return pghr13::verify_proof<libff::alt_bn128_pp>(vk_path, proof_path);
 }
 
-bool _pghr13_mnt4_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+bool _pghr13_verify_proofs(const char* vk_path, const char* const* proof_paths, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_verify_proofs");
+  return pghr13::verify_proofs<libff::alt_bn128_pp>(vk_path, proof_paths, count, results);
+}
+
+bool _pghr13_prepare_proving_key(const char* pk_path, int window, int threads)
 {
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_prepare_proving_key");
+  return pghr13::prepareProvingKey<libff::alt_bn128_pp>(pk_path, window);
+}
+
+bool _pghr13_mnt4_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
+{
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_setup");
   return pghr13::setup<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk_path, vk_path);
 }
 
-bool _pghr13_mnt4_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length)
+bool _pghr13_mnt4_setup_streamed(constraint_chunk_callback next_chunk, void* state, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_setup_streamed");
+  return pghr13::setup<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(next_chunk, state, constraints, variables, inputs, pk_path, vk_path);
+}
+
+bool _pghr13_mnt4_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, int threads)
 {
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_generate_proof");
   return pghr13::generate_proof<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(pk_path, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length);
 }
 
+bool _pghr13_mnt4_generate_proof_limbs(const char* pk_path, const char* proof_path, uint64_t* witness, int public_inputs_length, int variables, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_generate_proof_limbs");
+  return pghr13::generate_proof<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(pk_path, proof_path, witness, public_inputs_length, variables);
+}
+
+bool _pghr13_mnt4_generate_proofs_limbs(const char* pk_path, const char* const* proof_paths, uint64_t* const* witnesses, int count, int public_inputs_length, int variables, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_generate_proofs_limbs");
+  return pghr13::generate_proofs<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(pk_path, proof_paths, witnesses, count, public_inputs_length, variables, results);
+}
+
 bool _pghr13_mnt4_verify_proof(const char* vk_path, const char* proof_path)
 {
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_verify_proof");
   return pghr13::verify_proof<libff::mnt4_pp>(vk_path, proof_path);
 }
 
-bool _pghr13_mnt6_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path)
+bool _pghr13_mnt4_verify_proofs(const char* vk_path, const char* const* proof_paths, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_verify_proofs");
+  return pghr13::verify_proofs<libff::mnt4_pp>(vk_path, proof_paths, count, results);
+}
+
+bool _pghr13_mnt4_prepare_proving_key(const char* pk_path, int window, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_prepare_proving_key");
+  return pghr13::prepareProvingKey<libff::mnt4_pp>(pk_path, window);
+}
+
+bool _pghr13_mnt6_setup(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
 {
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_setup");
   return pghr13::setup<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk_path, vk_path);
 }
 
-bool _pghr13_mnt6_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length)
+bool _pghr13_mnt6_setup_streamed(constraint_chunk_callback next_chunk, void* state, int constraints, int variables, int inputs, const char* pk_path, const char* vk_path, int threads)
 {
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_setup_streamed");
+  return pghr13::setup<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(next_chunk, state, constraints, variables, inputs, pk_path, vk_path);
+}
+
+bool _pghr13_mnt6_generate_proof(const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_generate_proof");
   return pghr13::generate_proof<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(pk_path, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length);
 }
 
+bool _pghr13_mnt6_generate_proof_limbs(const char* pk_path, const char* proof_path, uint64_t* witness, int public_inputs_length, int variables, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_generate_proof_limbs");
+  return pghr13::generate_proof<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(pk_path, proof_path, witness, public_inputs_length, variables);
+}
+
+bool _pghr13_mnt6_generate_proofs_limbs(const char* pk_path, const char* const* proof_paths, uint64_t* const* witnesses, int count, int public_inputs_length, int variables, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_generate_proofs_limbs");
+  return pghr13::generate_proofs<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(pk_path, proof_paths, witnesses, count, public_inputs_length, variables, results);
+}
+
 bool _pghr13_mnt6_verify_proof(const char* vk_path, const char* proof_path)
 {
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_verify_proof");
   return pghr13::verify_proof<libff::mnt6_pp>(vk_path, proof_path);
 }
 
+bool _pghr13_mnt6_verify_proofs(const char* vk_path, const char* const* proof_paths, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_verify_proofs");
+  return pghr13::verify_proofs<libff::mnt6_pp>(vk_path, proof_paths, count, results);
+}
+
+bool _pghr13_mnt6_prepare_proving_key(const char* pk_path, int window, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_prepare_proving_key");
+  return pghr13::prepareProvingKey<libff::mnt6_pp>(pk_path, window);
+}
+
 bool _pghr13_mnt4_mnt6_batch(
     const char *vk_1_path, const char *proof_1_path,
     const char *vk_2_path, const char *proof_2_path,
-    const char *agg_vk_path, const char *agg_proof_path)
+    const char *agg_vk_path, const char *agg_proof_path, int threads)
 {
+  const char* vk_paths[] = { vk_1_path, vk_2_path };
+  const char* proof_paths[] = { proof_1_path, proof_2_path };
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt4_pp::init_public_params();
   libff::mnt6_pp::init_public_params();
-  return pghr13::batch<libff::mnt4_pp, libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(vk_1_path, proof_1_path, vk_2_path, proof_2_path, agg_vk_path, agg_proof_path);
+  profile_call profile("pghr13_mnt4_mnt6_batch");
+  return pghr13::batch<libff::mnt4_pp, libff::mnt6_pp>(vk_paths, proof_paths, 2, 2, agg_vk_path, agg_proof_path);
 }
 
 bool _pghr13_mnt6_mnt4_batch(
     const char *vk_1_path, const char *proof_1_path,
     const char *vk_2_path, const char *proof_2_path,
-    const char *agg_vk_path, const char *agg_proof_path)
+    const char *agg_vk_path, const char *agg_proof_path, int threads)
+{
+  const char* vk_paths[] = { vk_1_path, vk_2_path };
+  const char* proof_paths[] = { proof_1_path, proof_2_path };
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_mnt4_batch");
+  return pghr13::batch<libff::mnt6_pp, libff::mnt4_pp>(vk_paths, proof_paths, 2, 2, agg_vk_path, agg_proof_path);
+}
+
+bool _pghr13_mnt4_mnt6_batch_n(
+    const char* const* vk_paths, const char* const* proof_paths, int count,
+    const char *agg_vk_path, const char *agg_proof_path, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_mnt6_batch_n");
+  return pghr13::batch<libff::mnt4_pp, libff::mnt6_pp>(vk_paths, proof_paths, count, count, agg_vk_path, agg_proof_path);
+}
+
+bool _pghr13_mnt6_mnt4_batch_n(
+    const char* const* vk_paths, const char* const* proof_paths, int count,
+    const char *agg_vk_path, const char *agg_proof_path, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_mnt4_batch_n");
+  return pghr13::batch<libff::mnt6_pp, libff::mnt4_pp>(vk_paths, proof_paths, count, count, agg_vk_path, agg_proof_path);
+}
+
+bool _pghr13_mnt4_mnt6_batch_tree(
+    const char* const* vk_paths, const char* const* proof_paths, int count, int arity,
+    const char *agg_vk_path, const char *agg_proof_path, int threads)
 {
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_mnt6_batch_tree");
+  return pghr13::batch<libff::mnt4_pp, libff::mnt6_pp>(vk_paths, proof_paths, count, arity, agg_vk_path, agg_proof_path);
+}
+
+bool _pghr13_mnt6_mnt4_batch_tree(
+    const char* const* vk_paths, const char* const* proof_paths, int count, int arity,
+    const char *agg_vk_path, const char *agg_proof_path, int threads)
+{
+  setThreads(threads);
   libff::inhibit_profiling_info = true;
   libff::inhibit_profiling_counters = true;
   libff::mnt6_pp::init_public_params();
   libff::mnt4_pp::init_public_params();
-  return pghr13::batch<libff::mnt6_pp, libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(vk_1_path, proof_1_path, vk_2_path, proof_2_path, agg_vk_path, agg_proof_path);
+  profile_call profile("pghr13_mnt6_mnt4_batch_tree");
+  return pghr13::batch<libff::mnt6_pp, libff::mnt4_pp>(vk_paths, proof_paths, count, arity, agg_vk_path, agg_proof_path);
+}
+
+bool _pghr13_setup_buffers(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, struct buffer* pk, struct vk_buffers* vk, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_setup_buffers");
+  return pghr13::setup<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk, vk);
+}
+
+bool _pghr13_generate_proof_buffers(struct byte_range pk, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, struct proof_buffers* proof, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_generate_proof_buffers");
+  return pghr13::generate_proof<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>(pk, public_inputs, public_inputs_length, private_inputs, private_inputs_length, proof);
+}
+
+bool _pghr13_verify_proofs_buffers(struct byte_range vk, const struct proof_range* proofs, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::alt_bn128_pp::init_public_params();
+  profile_call profile("pghr13_verify_proofs_buffers");
+  return pghr13::verify_proofs<libff::alt_bn128_pp>(vk, proofs, count, results);
+}
+
+bool _pghr13_mnt4_setup_buffers(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, struct buffer* pk, struct vk_buffers* vk, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_setup_buffers");
+  return pghr13::setup<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk, vk);
+}
+
+bool _pghr13_mnt4_generate_proof_buffers(struct byte_range pk, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, struct proof_buffers* proof, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_generate_proof_buffers");
+  return pghr13::generate_proof<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>(pk, public_inputs, public_inputs_length, private_inputs, private_inputs_length, proof);
+}
+
+bool _pghr13_mnt4_verify_proofs_buffers(struct byte_range vk, const struct proof_range* proofs, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_verify_proofs_buffers");
+  return pghr13::verify_proofs<libff::mnt4_pp>(vk, proofs, count, results);
+}
+
+bool _pghr13_mnt6_setup_buffers(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, struct buffer* pk, struct vk_buffers* vk, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_setup_buffers");
+  return pghr13::setup<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(A, B, C, A_len, B_len, C_len, constraints, variables, inputs, pk, vk);
+}
+
+bool _pghr13_mnt6_generate_proof_buffers(struct byte_range pk, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, struct proof_buffers* proof, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_generate_proof_buffers");
+  return pghr13::generate_proof<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>(pk, public_inputs, public_inputs_length, private_inputs, private_inputs_length, proof);
+}
+
+bool _pghr13_mnt6_verify_proofs_buffers(struct byte_range vk, const struct proof_range* proofs, int count, bool* results, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_verify_proofs_buffers");
+  return pghr13::verify_proofs<libff::mnt6_pp>(vk, proofs, count, results);
+}
+
+bool _pghr13_mnt4_mnt6_batch_buffers(
+    const struct byte_range* vks, const struct proof_range* proofs, int count, int arity,
+    struct vk_buffers* agg_vk, struct proof_buffers* agg_proof, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt4_pp::init_public_params();
+  libff::mnt6_pp::init_public_params();
+  profile_call profile("pghr13_mnt4_mnt6_batch_buffers");
+  return pghr13::batch<libff::mnt4_pp, libff::mnt6_pp>(vks, proofs, count, arity, agg_vk, agg_proof);
+}
+
+bool _pghr13_mnt6_mnt4_batch_buffers(
+    const struct byte_range* vks, const struct proof_range* proofs, int count, int arity,
+    struct vk_buffers* agg_vk, struct proof_buffers* agg_proof, int threads)
+{
+  setThreads(threads);
+  libff::inhibit_profiling_info = true;
+  libff::inhibit_profiling_counters = true;
+  libff::mnt6_pp::init_public_params();
+  libff::mnt4_pp::init_public_params();
+  profile_call profile("pghr13_mnt6_mnt4_batch_buffers");
+  return pghr13::batch<libff::mnt6_pp, libff::mnt4_pp>(vks, proofs, count, arity, agg_vk, agg_proof);
+}
+
+void* _pghr13_context_new()
+{
+  return new pghr13::curve_context<libff::alt_bn128_q_limbs, libff::alt_bn128_r_limbs, libff::alt_bn128_pp, libff::alt_bn128_G1, libff::alt_bn128_G2>();
+}
+
+void* _pghr13_mnt4_context_new()
+{
+  return new pghr13::curve_context<libff::mnt4_q_limbs, libff::mnt4_r_limbs, libff::mnt4_pp, libff::mnt4_G1, libff::mnt4_G2>();
+}
+
+void* _pghr13_mnt6_context_new()
+{
+  return new pghr13::curve_context<libff::mnt6_q_limbs, libff::mnt6_r_limbs, libff::mnt6_pp, libff::mnt6_G1, libff::mnt6_G2>();
+}
+
+void _pghr13_context_free(void* context)
+{
+  delete (pghr13::context*) context;
+}
+
+bool _pghr13_context_generate_proof(void* context, const char* pk_path, const char* proof_path, const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length, int threads)
+{
+  setThreads(threads);
+  profile_call profile("pghr13_context_generate_proof");
+  return ((pghr13::context*) context)->generate_proof(pk_path, proof_path, public_inputs, public_inputs_length, private_inputs, private_inputs_length);
 }
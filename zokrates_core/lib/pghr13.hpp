@@ -14,6 +14,9 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "buffer.hpp"
+#include "constraint_stream.hpp"
+
 bool _pghr13_setup(const uint8_t* A,
             const uint8_t* B,
             const uint8_t* C,
@@ -24,7 +27,19 @@ bool _pghr13_setup(const uint8_t* A,
             int variables,
             int inputs,
             const char* pk_path,
-            const char* vk_path
+            const char* vk_path,
+            int threads
+          );
+
+// same as _pghr13_setup, with the constraint rows pulled from `next_chunk` instead of passed at once
+bool _pghr13_setup_streamed(constraint_chunk_callback next_chunk,
+            void* state,
+            int constraints,
+            int variables,
+            int inputs,
+            const char* pk_path,
+            const char* vk_path,
+            int threads
           );
 
 bool _pghr13_generate_proof(const char* pk_path,
@@ -32,7 +47,31 @@ bool _pghr13_generate_proof(const char* pk_path,
             const uint8_t* public_inputs,
             int public_inputs_length,
             const uint8_t* private_inputs,
-            int private_inputs_length
+            int private_inputs_length,
+            int threads
+          );
+
+// `witness` holds every variable, public ones (starting with ~one) first, as
+// little-endian 64-bit limbs; it is overwritten with the Montgomery form of the values
+bool _pghr13_generate_proof_limbs(const char* pk_path,
+            const char* proof_path,
+            uint64_t* witness,
+            int public_inputs_length,
+            int variables,
+            int threads
+          );
+
+// proves each of the `count` witnesses, laid out as for _pghr13_generate_proof_limbs, against the
+// key at pk_path, loaded once, writing proof i to proof_paths[i] and whether it was written to
+// results[i]; returns true if all of them were. Proofs run concurrently in multicore builds.
+bool _pghr13_generate_proofs_limbs(const char* pk_path,
+            const char* const* proof_paths,
+            uint64_t* const* witnesses,
+            int count,
+            int public_inputs_length,
+            int variables,
+            bool* results,
+            int threads
           );
 
 bool _pghr13_verify_proof(
@@ -40,6 +79,24 @@ bool _pghr13_verify_proof(
         const char* proof_path
         );
 
+// verifies each of `proof_paths` against the vk at `vk_path`, writing one result per proof;
+// returns true if all of them hold
+bool _pghr13_verify_proofs(
+        const char* vk_path,
+        const char* const* proof_paths,
+        int count,
+        bool* results,
+        int threads
+        );
+
+// writes the fixed-base tables of the prover's multi-exponentiations to <pk_path>.prepared,
+// with the digest of the key file; the provers use them from then on, as long as the key
+// file is unchanged. `window` is the width in bits of the scalar digits, 0 picks one per table
+bool _pghr13_prepare_proving_key(const char* pk_path,
+            int window,
+            int threads
+          );
+
 bool _pghr13_mnt4_setup(const uint8_t* A,
             const uint8_t* B,
             const uint8_t* C,
@@ -50,7 +107,18 @@ bool _pghr13_mnt4_setup(const uint8_t* A,
             int variables,
             int inputs,
             const char* pk_path,
-            const char* vk_path
+            const char* vk_path,
+            int threads
+          );
+
+bool _pghr13_mnt4_setup_streamed(constraint_chunk_callback next_chunk,
+            void* state,
+            int constraints,
+            int variables,
+            int inputs,
+            const char* pk_path,
+            const char* vk_path,
+            int threads
           );
 
 bool _pghr13_mnt4_generate_proof(const char* pk_path,
@@ -58,7 +126,26 @@ bool _pghr13_mnt4_generate_proof(const char* pk_path,
             const uint8_t* public_inputs,
             int public_inputs_length,
             const uint8_t* private_inputs,
-            int private_inputs_length
+            int private_inputs_length,
+            int threads
+          );
+
+bool _pghr13_mnt4_generate_proof_limbs(const char* pk_path,
+            const char* proof_path,
+            uint64_t* witness,
+            int public_inputs_length,
+            int variables,
+            int threads
+          );
+
+bool _pghr13_mnt4_generate_proofs_limbs(const char* pk_path,
+            const char* const* proof_paths,
+            uint64_t* const* witnesses,
+            int count,
+            int public_inputs_length,
+            int variables,
+            bool* results,
+            int threads
           );
 
 bool _pghr13_mnt4_verify_proof(
@@ -66,6 +153,19 @@ bool _pghr13_mnt4_verify_proof(
         const char* proof_path
         );
 
+bool _pghr13_mnt4_verify_proofs(
+        const char* vk_path,
+        const char* const* proof_paths,
+        int count,
+        bool* results,
+        int threads
+        );
+
+bool _pghr13_mnt4_prepare_proving_key(const char* pk_path,
+            int window,
+            int threads
+          );
+
 bool _pghr13_mnt6_setup(const uint8_t* A,
             const uint8_t* B,
             const uint8_t* C,
@@ -76,7 +176,18 @@ bool _pghr13_mnt6_setup(const uint8_t* A,
             int variables,
             int inputs,
             const char* pk_path,
-            const char* vk_path
+            const char* vk_path,
+            int threads
+          );
+
+bool _pghr13_mnt6_setup_streamed(constraint_chunk_callback next_chunk,
+            void* state,
+            int constraints,
+            int variables,
+            int inputs,
+            const char* pk_path,
+            const char* vk_path,
+            int threads
           );
 
 bool _pghr13_mnt6_generate_proof(const char* pk_path,
@@ -84,7 +195,26 @@ bool _pghr13_mnt6_generate_proof(const char* pk_path,
             const uint8_t* public_inputs,
             int public_inputs_length,
             const uint8_t* private_inputs,
-            int private_inputs_length
+            int private_inputs_length,
+            int threads
+          );
+
+bool _pghr13_mnt6_generate_proof_limbs(const char* pk_path,
+            const char* proof_path,
+            uint64_t* witness,
+            int public_inputs_length,
+            int variables,
+            int threads
+          );
+
+bool _pghr13_mnt6_generate_proofs_limbs(const char* pk_path,
+            const char* const* proof_paths,
+            uint64_t* const* witnesses,
+            int count,
+            int public_inputs_length,
+            int variables,
+            bool* results,
+            int threads
           );
 
 bool _pghr13_mnt6_verify_proof(
@@ -92,18 +222,195 @@ bool _pghr13_mnt6_verify_proof(
         const char* proof_path
         );
 
+bool _pghr13_mnt6_verify_proofs(
+        const char* vk_path,
+        const char* const* proof_paths,
+        int count,
+        bool* results,
+        int threads
+        );
+
+bool _pghr13_mnt6_prepare_proving_key(const char* pk_path,
+            int window,
+            int threads
+          );
+
 bool _pghr13_mnt4_mnt6_batch(
     const char *vk_1_path, const char *proof_1_path,
     const char *vk_2_path, const char *proof_2_path,
-    const char *agg_vk_path, const char *agg_proof_path
+    const char *agg_vk_path, const char *agg_proof_path,
+    int threads
     );
 
 bool _pghr13_mnt6_mnt4_batch(
     const char *vk_1_path, const char *proof_1_path,
     const char *vk_2_path, const char *proof_2_path,
-    const char *agg_vk_path, const char *agg_proof_path
+    const char *agg_vk_path, const char *agg_proof_path,
+    int threads
+    );
+
+// aggregate `count` proofs into a single proof of arity `count`
+bool _pghr13_mnt4_mnt6_batch_n(
+    const char* const* vk_paths, const char* const* proof_paths, int count,
+    const char *agg_vk_path, const char *agg_proof_path,
+    int threads
+    );
+
+bool _pghr13_mnt6_mnt4_batch_n(
+    const char* const* vk_paths, const char* const* proof_paths, int count,
+    const char *agg_vk_path, const char *agg_proof_path,
+    int threads
+    );
+
+// aggregate `count` proofs `arity` at a time, alternating curves layer after layer
+// until a single proof is left
+bool _pghr13_mnt4_mnt6_batch_tree(
+    const char* const* vk_paths, const char* const* proof_paths, int count, int arity,
+    const char *agg_vk_path, const char *agg_proof_path,
+    int threads
     );
 
+bool _pghr13_mnt6_mnt4_batch_tree(
+    const char* const* vk_paths, const char* const* proof_paths, int count, int arity,
+    const char *agg_vk_path, const char *agg_proof_path,
+    int threads
+    );
+
+// same as _pghr13_setup, handing the keys over in buffers instead of writing them to files
+bool _pghr13_setup_buffers(const uint8_t* A,
+            const uint8_t* B,
+            const uint8_t* C,
+            int A_len,
+            int B_len,
+            int C_len,
+            int constraints,
+            int variables,
+            int inputs,
+            struct buffer* pk,
+            struct vk_buffers* vk,
+            int threads
+          );
+
+// same as _pghr13_generate_proof, reading the proving key from `pk` and handing the proof over in buffers
+bool _pghr13_generate_proof_buffers(struct byte_range pk,
+            const uint8_t* public_inputs,
+            int public_inputs_length,
+            const uint8_t* private_inputs,
+            int private_inputs_length,
+            struct proof_buffers* proof,
+            int threads
+          );
+
+// same as _pghr13_verify_proofs, with the raw vk and proofs in memory
+bool _pghr13_verify_proofs_buffers(
+        struct byte_range vk,
+        const struct proof_range* proofs,
+        int count,
+        bool* results,
+        int threads
+        );
+
+// same as _pghr13_mnt4_setup, handing the keys over in buffers instead of writing them to files
+bool _pghr13_mnt4_setup_buffers(const uint8_t* A,
+            const uint8_t* B,
+            const uint8_t* C,
+            int A_len,
+            int B_len,
+            int C_len,
+            int constraints,
+            int variables,
+            int inputs,
+            struct buffer* pk,
+            struct vk_buffers* vk,
+            int threads
+          );
+
+// same as _pghr13_mnt4_generate_proof, reading the proving key from `pk` and handing the proof over in buffers
+bool _pghr13_mnt4_generate_proof_buffers(struct byte_range pk,
+            const uint8_t* public_inputs,
+            int public_inputs_length,
+            const uint8_t* private_inputs,
+            int private_inputs_length,
+            struct proof_buffers* proof,
+            int threads
+          );
+
+// same as _pghr13_mnt4_verify_proofs, with the raw vk and proofs in memory
+bool _pghr13_mnt4_verify_proofs_buffers(
+        struct byte_range vk,
+        const struct proof_range* proofs,
+        int count,
+        bool* results,
+        int threads
+        );
+
+// same as _pghr13_mnt6_setup, handing the keys over in buffers instead of writing them to files
+bool _pghr13_mnt6_setup_buffers(const uint8_t* A,
+            const uint8_t* B,
+            const uint8_t* C,
+            int A_len,
+            int B_len,
+            int C_len,
+            int constraints,
+            int variables,
+            int inputs,
+            struct buffer* pk,
+            struct vk_buffers* vk,
+            int threads
+          );
+
+// same as _pghr13_mnt6_generate_proof, reading the proving key from `pk` and handing the proof over in buffers
+bool _pghr13_mnt6_generate_proof_buffers(struct byte_range pk,
+            const uint8_t* public_inputs,
+            int public_inputs_length,
+            const uint8_t* private_inputs,
+            int private_inputs_length,
+            struct proof_buffers* proof,
+            int threads
+          );
+
+// same as _pghr13_mnt6_verify_proofs, with the raw vk and proofs in memory
+bool _pghr13_mnt6_verify_proofs_buffers(
+        struct byte_range vk,
+        const struct proof_range* proofs,
+        int count,
+        bool* results,
+        int threads
+        );
+
+// same as the _batch_tree functions, with the raw vks and proofs in memory and the
+// aggregate handed over in buffers; `arity` equal to `count` aggregates all proofs at once
+bool _pghr13_mnt4_mnt6_batch_buffers(
+    const struct byte_range* vks, const struct proof_range* proofs, int count, int arity,
+    struct vk_buffers* agg_vk, struct proof_buffers* agg_proof,
+    int threads
+    );
+
+bool _pghr13_mnt6_mnt4_batch_buffers(
+    const struct byte_range* vks, const struct proof_range* proofs, int count, int arity,
+    struct vk_buffers* agg_vk, struct proof_buffers* agg_proof,
+    int threads
+    );
+
+// prover contexts keeping curve parameters and proving keys loaded across calls
+void* _pghr13_context_new();
+
+void* _pghr13_mnt4_context_new();
+
+void* _pghr13_mnt6_context_new();
+
+void _pghr13_context_free(void* context);
+
+bool _pghr13_context_generate_proof(void* context,
+            const char* pk_path,
+            const char* proof_path,
+            const uint8_t* public_inputs,
+            int public_inputs_length,
+            const uint8_t* private_inputs,
+            int private_inputs_length,
+            int threads
+          );
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
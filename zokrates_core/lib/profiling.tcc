@@ -0,0 +1,225 @@
+#pragma once
+
+/**
+ * @file profiling.tcc
+ * Opt-in per-call profiling of the backends. With ZOKRATES_PROFILE set to a
+ * directory, every profiled entry point writes `<call>-<pid>-<n>.json` there:
+ * wall time, CPU time and peak RSS of the whole call and of each phase, plus
+ * the libff blocks libsnark timed meanwhile. The prover's FFTs ("Compute the
+ * polynomial H") and multi-exponentiations ("Compute the proof") are also
+ * reported as phases. Peak RSS is the process high-water mark when a phase ends.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <libff/common/profiling.hpp>
+
+#include "util.tcc"
+
+struct profile_sample {
+  double wall;
+  double cpu;
+
+  static profile_sample now()
+  {
+    timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    profile_sample s;
+    s.wall = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    s.cpu = cpu.tv_sec + cpu.tv_nsec * 1e-9;
+    return s;
+  }
+};
+
+inline long peakRssKb()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+struct profile_phase_record {
+  std::string name;
+  double wall_seconds;
+  double cpu_seconds;
+  long peak_rss_kb;
+};
+
+// report of the entry point being profiled; phases outside of one are not recorded
+class profile_call {
+  public:
+    explicit profile_call(const char* name) : name(name), start(profile_sample::now())
+    {
+      const char* dir = getenv("ZOKRATES_PROFILE");
+      if (dir == nullptr || *dir == '\0' || active() != nullptr)
+        return;
+      directory = dir;
+      active() = this;
+      // libff only times its blocks when counters are on; they stay off the output as long
+      // as inhibit_profiling_info is set
+      libff::inhibit_profiling_counters = false;
+      libff::invocation_counts.clear();
+      libff::cumulative_times.clear();
+      libff::last_cpu_times.clear();
+    }
+
+    ~profile_call()
+    {
+      if (active() != this)
+        return;
+      active() = nullptr;
+      libff::inhibit_profiling_counters = true;
+      write();
+    }
+
+    profile_call(const profile_call&) = delete;
+    profile_call& operator=(const profile_call&) = delete;
+
+    void record(const profile_phase_record& phase)
+    {
+      phases.push_back(phase);
+    }
+
+    static profile_call*& active()
+    {
+      static profile_call* call = nullptr;
+      return call;
+    }
+
+  private:
+    void write()
+    {
+      const profile_sample end = profile_sample::now();
+      static std::atomic<int> sequence(0);
+
+      text_buffer out(4096);
+      out << "{\n  \"call\": \"" << name << "\",\n";
+#ifdef MULTICORE
+      out << "  \"threads\": " << (uint64_t) omp_get_max_threads() << ",\n";
+#else
+      out << "  \"threads\": " << (uint64_t) 1 << ",\n";
+#endif
+      out << "  \"wall_seconds\": " << number(end.wall - start.wall) << ",\n";
+      out << "  \"cpu_seconds\": " << number(end.cpu - start.cpu) << ",\n";
+      out << "  \"peak_rss_kb\": " << (uint64_t) peakRssKb() << ",\n";
+      // the prover's own phases, as timed by libsnark; their peak RSS is not known
+      addBlockPhase("prover_fft", "Compute the polynomial H");
+      addBlockPhase("prover_multiexp", "Compute the proof");
+
+      out << "  \"phases\": [";
+      for (size_t i = 0; i < phases.size(); i++) {
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"name\": \"" << phases[i].name << "\", \"wall_seconds\": " << number(phases[i].wall_seconds)
+            << ", \"cpu_seconds\": " << number(phases[i].cpu_seconds) << ", \"peak_rss_kb\": ";
+        if (phases[i].peak_rss_kb < 0)
+          out << "null}";
+        else
+          out << (uint64_t) phases[i].peak_rss_kb << "}";
+      }
+      out << "\n  ],\n";
+      out << "  \"libsnark_blocks\": [";
+      bool first = true;
+      for (const auto& block : libff::invocation_counts) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {\"name\": \"" << escaped(block.first) << "\", \"count\": " << (uint64_t) block.second
+            << ", \"wall_seconds\": " << number(libff::cumulative_times[block.first] * 1e-9)
+            << ", \"last_cpu_seconds\": " << number(libff::last_cpu_times[block.first] * 1e-9) << "}";
+      }
+      out << "\n  ]\n}\n";
+
+      const std::string path = directory + "/" + name + "-" + std::to_string(getpid()) + "-" + std::to_string(sequence++) + ".json";
+      if (!makeDirectories(directory) || !out.write_to(path.c_str()))
+        std::cerr << "could not write profile " << path << std::endl;
+    }
+
+    void addBlockPhase(const char* phase, const char* block)
+    {
+      if (libff::invocation_counts.count(block) != 0)
+        phases.push_back({ phase, libff::cumulative_times[block] * 1e-9, libff::last_cpu_times[block] * 1e-9, -1 });
+    }
+
+    static std::string number(double x)
+    {
+      char digits[32];
+      snprintf(digits, sizeof(digits), "%.6f", x);
+      return digits;
+    }
+
+    static std::string escaped(const std::string& s)
+    {
+      std::string e;
+      for (char c : s) {
+        if (c == '"' || c == '\\')
+          e += '\\';
+        if ((unsigned char) c >= 0x20)
+          e += c;
+      }
+      return e;
+    }
+
+    std::string name;
+    std::string directory;
+    profile_sample start;
+    std::vector<profile_phase_record> phases;
+};
+
+// times the enclosing scope as one phase of the active profile_call, if any
+class profile_phase {
+  public:
+    explicit profile_phase(const char* name) : name(name), call(profile_call::active())
+    {
+      if (call != nullptr)
+        start = profile_sample::now();
+    }
+
+    ~profile_phase()
+    {
+      end();
+    }
+
+    // ends the phase before the end of the scope
+    void end()
+    {
+      if (call == nullptr)
+        return;
+      const profile_sample now = profile_sample::now();
+      call->record({ name, now.wall - start.wall, now.cpu - start.cpu, peakRssKb() });
+      call = nullptr;
+    }
+
+    profile_phase(const profile_phase&) = delete;
+    profile_phase& operator=(const profile_phase&) = delete;
+
+  private:
+    const char* name;
+    profile_call* call;
+    profile_sample start;
+};
+
+// libff's block timers are not thread-safe; they are paused while a parallel section runs
+class libff_timers_paused {
+  public:
+    libff_timers_paused() : previous(libff::inhibit_profiling_counters)
+    {
+      libff::inhibit_profiling_counters = true;
+    }
+
+    ~libff_timers_paused()
+    {
+      libff::inhibit_profiling_counters = previous;
+    }
+
+    libff_timers_paused(const libff_timers_paused&) = delete;
+    libff_timers_paused& operator=(const libff_timers_paused&) = delete;
+
+  private:
+    bool previous;
+};
@@ -0,0 +1,330 @@
+#pragma once
+
+/**
+ * @file prover.tcc
+ * Fixed-base tables for the provers' multi-exponentiations. Every proof
+ * multiplies the same proving key bases by new scalars, so a prepared key
+ * stores each base P multiplied by 2^(window*j) for every window j of a
+ * scalar. A multi-exponentiation then adds each table point into the bucket
+ * of its scalar digit, in a single pass without doublings, and reduces the
+ * buckets once instead of once per window.
+ *
+ * Tables are written next to the proving key as <pk>.prepared, by the
+ * `*_prepare_proving_key` entry points, and mapped in place by the provers.
+ * Their header records the SHA-256 of the key file they were prepared from,
+ * with its size, inode and mtime, and the provers ignore tables recorded for
+ * another file.
+ *
+ * Witnesses of hashes and bit decompositions are mostly zeros and ones, so
+ * both multi-exponentiations skip zero scalars and add the base of a scalar
+ * one directly; without tables, only the other scalars go through libff's.
+ * Bases at infinity, left by the variables missing from A and B, are skipped
+ * the same way.
+ *
+ * Also spreads the proofs of a batch over the threads.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <libff/algebra/scalar_multiplication/multiexp.hpp>
+
+#include "util.tcc"
+#include "binary_format.tcc"
+
+// the bases of one multi-exponentiation, `shifts` points per base
+template<typename GT>
+struct fixed_base_table {
+  const GT* points = nullptr;
+  uint64_t bases = 0;
+  uint64_t shifts = 0;
+  uint64_t window = 0;
+};
+
+inline std::string preparedKeyPath(const char* pk_path)
+{
+  return std::string(pk_path).append(".prepared");
+}
+
+// the buckets of all the threads of one multi-exponentiation stay within this many bytes
+const size_t FIXED_BASE_BUCKET_BYTES = size_t(1) << 30;
+
+// widest window whose 2^window - 1 buckets of one thread fit in the bucket budget
+template<typename GT>
+size_t maxFixedBaseWindow()
+{
+  size_t window = 1;
+  while (window < 24 && ((size_t(1) << (window + 1)) - 1) * sizeof(GT) <= FIXED_BASE_BUCKET_BYTES)
+    window++;
+  return window;
+}
+
+// window width minimising the additions for `bases` bases: each scalar adds
+// one point per window, and each thread reduces 2^window buckets
+inline size_t fixedBaseWindow(size_t bases)
+{
+  size_t log = 0;
+  while (log < 63 && (size_t(1) << (log + 1)) <= bases)
+    log++;
+  return std::max<size_t>(4, std::min<size_t>(20, log > 7 ? log - 3 : 4));
+}
+
+// bases, shifts and window, then the shifted bases in special form, base after base
+template<typename GT, typename BaseF>
+void writeFixedBaseTable(binary_writer& writer, size_t bases, size_t scalar_bits, size_t window, BaseF base)
+{
+  if (window == 0)
+    window = fixedBaseWindow(bases);
+  window = std::min(window, maxFixedBaseWindow<GT>());
+  const size_t shifts = (scalar_bits + window - 1) / window;
+  writer.write<uint64_t>(bases);
+  writer.write<uint64_t>(shifts);
+  writer.write<uint64_t>(window);
+
+  // a block at a time, so that only the key and one block are in memory
+  const size_t block = 1 << 12;
+  std::vector<GT> shifted;
+  for (size_t start = 0; start < bases; start += block) {
+    const size_t end = std::min(bases, start + block);
+    shifted.resize((end - start) * shifts);
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(static)
+#endif
+    for (size_t i = start; i < end; i++) {
+      GT p = base(i);
+      for (size_t j = 0; j < shifts; j++) {
+        GT special = p;
+        special.to_special();
+        shifted[(i - start) * shifts + j] = special;
+        for (size_t k = 0; k < window; k++)
+          p = p.dbl();
+      }
+    }
+    writer.write_array(shifted.data(), shifted.size());
+  }
+}
+
+template<typename GT>
+bool readFixedBaseTable(binary_reader& reader, fixed_base_table<GT>& table)
+{
+  if (!reader.read(table.bases) || !reader.read(table.shifts) || !reader.read(table.window)
+      || table.window == 0 || table.window > maxFixedBaseWindow<GT>() || table.shifts == 0)
+    return false;
+  return reader.view_array(table.points, table.bases * table.shifts);
+}
+
+// the proving key file the tables were prepared from, recorded after their header: its
+// identity, then its SHA-256 in hex. A digest is 64 bytes, which keeps the tables aligned.
+struct prepared_key_source {
+  file_identity identity;
+  std::string digest;
+};
+
+inline bool keySource(const char* pk_path, prepared_key_source& source)
+{
+  return fileIdentity(pk_path, source.identity) && fileDigest(pk_path, source.digest);
+}
+
+inline void writeKeySource(binary_writer& writer, const prepared_key_source& source)
+{
+  writer.write(source.identity);
+  writer.write<uint64_t>(source.digest.size());
+  writer.write_array(source.digest.data(), source.digest.size());
+}
+
+inline bool readKeySource(binary_reader& reader, prepared_key_source& source)
+{
+  uint64_t length;
+  const char* data;
+  if (!reader.read(source.identity) || !reader.read(length) || length % 8 != 0 || !reader.view_array(data, length))
+    return false;
+  source.digest.assign(data, length);
+  return true;
+}
+
+// the key file at pk_path is the one the tables were prepared from. It is only hashed again
+// when its identity changed, as it does when the key is copied or set up again.
+inline bool preparedFromKeyFile(const prepared_key_source& source, const char* pk_path)
+{
+  file_identity identity;
+  if (!fileIdentity(pk_path, identity))
+    return false;
+  if (identity == source.identity)
+    return true;
+  std::string digest;
+  return fileDigest(pk_path, digest) && digest == source.digest;
+}
+
+template<mp_size_t n>
+size_t scalarDigit(const libff::bigint<n>& scalar, size_t bit, size_t width)
+{
+  const size_t limb = bit / GMP_NUMB_BITS;
+  const size_t offset = bit % GMP_NUMB_BITS;
+  if (limb >= (size_t) n)
+    return 0;
+  uint64_t digit = scalar.data[limb] >> offset;
+  if (offset + width > GMP_NUMB_BITS && limb + 1 < (size_t) n)
+    digit |= scalar.data[limb + 1] << (GMP_NUMB_BITS - offset);
+  return digit & ((uint64_t(1) << width) - 1);
+}
+
+// sum of scalars[i] * base(first + i) for i < count. Each thread fills its own
+// buckets from a slice of the bases, with no more threads than the bucket budget
+// allows; the bucket sums are added at the end.
+template<typename GT, typename FieldT>
+GT fixedBaseMultiExp(const fixed_base_table<GT>& table, size_t first, const FieldT* scalars, size_t count)
+{
+  const size_t window = table.window;
+  const size_t shifts = table.shifts;
+  count = std::min<size_t>(count, table.bases > first ? table.bases - first : 0);
+#ifdef MULTICORE
+  const size_t bucket_bytes = ((size_t(1) << window) - 1) * sizeof(GT);
+  const size_t chunks = std::max<size_t>(1, std::min<size_t>(
+      std::min<size_t>(omp_get_max_threads(), count >> window), FIXED_BASE_BUCKET_BYTES / bucket_bytes));
+#else
+  const size_t chunks = 1;
+#endif
+  const FieldT one = FieldT::one();
+  std::vector<GT> partial(chunks, GT::zero());
+
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(static) num_threads(chunks)
+#endif
+  for (size_t c = 0; c < chunks; c++) {
+    // buckets[d - 1] collects the points whose digit is d
+    std::vector<GT> buckets((size_t(1) << window) - 1, GT::zero());
+    const size_t end = count * (c + 1) / chunks;
+    for (size_t i = count * c / chunks; i < end; i++) {
+      const GT* shifted = table.points + (first + i) * shifts;
+      if (scalars[i].is_zero() || shifted[0].is_zero())
+        continue;
+      if (scalars[i] == one) {
+        buckets[0] = buckets[0].mixed_add(shifted[0]);
+        continue;
+      }
+      const auto scalar = scalars[i].as_bigint();
+      for (size_t j = 0; j < shifts; j++) {
+        const size_t digit = scalarDigit(scalar, j * window, window);
+        if (digit != 0)
+          buckets[digit - 1] = buckets[digit - 1].mixed_add(shifted[j]);
+      }
+    }
+
+    // sum of d * buckets[d - 1], as a sum of running sums from the top bucket down
+    GT running = GT::zero();
+    GT sum = GT::zero();
+    for (size_t d = buckets.size(); d > 0; d--) {
+      running = running + buckets[d - 1];
+      sum = sum + running;
+    }
+    partial[c] = sum;
+  }
+
+  GT result = GT::zero();
+  for (const GT& p : partial)
+    result = result + p;
+  return result;
+}
+
+// the bases of a multi-exponentiation as the proving key holds them
+template<typename GT>
+struct key_bases {
+  const GT* points = nullptr;
+  size_t count = 0;
+};
+
+template<typename GT>
+key_bases<GT> keyBases(const std::vector<GT>& points)
+{
+  key_bases<GT> bases;
+  bases.points = points.data();
+  bases.count = points.size();
+  return bases;
+}
+
+// sum of scalars[i] * base(first + i) for i < count: zero scalars and bases are skipped, ones added
+// to a sum per thread, and the remaining scalars and their bases gathered, in order, for
+// libff's multi-exponentiation
+template<typename GT, typename FieldT>
+GT partitionedMultiExp(const key_bases<GT>& bases, size_t first, const FieldT* scalars, size_t count)
+{
+  count = std::min<size_t>(count, bases.count > first ? bases.count - first : 0);
+#ifdef MULTICORE
+  const size_t chunks = std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), count >> 10));
+#else
+  const size_t chunks = 1;
+#endif
+  const FieldT one = FieldT::one();
+  std::vector<GT> ones(chunks, GT::zero());
+  std::vector<std::vector<size_t>> general(chunks);
+
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(static) num_threads(chunks)
+#endif
+  for (size_t c = 0; c < chunks; c++) {
+    const size_t end = count * (c + 1) / chunks;
+    for (size_t i = count * c / chunks; i < end; i++) {
+      const GT& base = bases.points[first + i];
+      if (scalars[i].is_zero() || base.is_zero())
+        continue;
+      if (scalars[i] == one)
+        ones[c] = base.is_special() ? ones[c].mixed_add(base) : ones[c] + base;
+      else
+        general[c].push_back(i);
+    }
+  }
+
+  std::vector<GT> general_bases;
+  std::vector<FieldT> general_scalars;
+  for (const std::vector<size_t>& indices : general) {
+    for (size_t i : indices) {
+      general_bases.push_back(bases.points[first + i]);
+      general_scalars.push_back(scalars[i]);
+    }
+  }
+
+  GT result = general_bases.empty() ? GT::zero()
+    : libff::multi_exp<GT, FieldT, libff::multi_exp_method_BDLO12>(general_bases.begin(), general_bases.end(),
+        general_scalars.begin(), general_scalars.end(), std::max<size_t>(1, chunks));
+  for (const GT& p : ones)
+    result = result + p;
+  return result;
+}
+
+// the provers' multi-exponentiations, over the tables of a prepared key or the key itself
+template<typename GT, typename FieldT>
+GT multiExp(const fixed_base_table<GT>& table, size_t first, const FieldT* scalars, size_t count)
+{
+  return fixedBaseMultiExp(table, first, scalars, count);
+}
+
+template<typename GT, typename FieldT>
+GT multiExp(const key_bases<GT>& bases, size_t first, const FieldT* scalars, size_t count)
+{
+  return partitionedMultiExp(bases, first, scalars, count);
+}
+
+// calls prove(i) for every i < count, as many at a time as there are threads; when there are
+// fewer proofs than threads, the spare threads run the parallel loops within each proof
+template<typename ProveF>
+void forEachProof(int count, ProveF prove)
+{
+#ifdef MULTICORE
+  const int threads = omp_get_max_threads();
+  const int concurrent = std::max(1, std::min(count, threads));
+  const int inner = std::max(1, threads / concurrent);
+  const int levels = omp_get_max_active_levels();
+  omp_set_max_active_levels(std::max(levels, 2));
+  #pragma omp parallel for schedule(dynamic) num_threads(concurrent)
+#endif
+  for (int i = 0; i < count; i++) {
+#ifdef MULTICORE
+    omp_set_num_threads(inner);
+#endif
+    prove(i);
+  }
+#ifdef MULTICORE
+  omp_set_max_active_levels(levels);
+#endif
+}
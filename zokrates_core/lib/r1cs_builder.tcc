@@ -0,0 +1,159 @@
+#pragma once
+
+/**
+ * @file r1cs_builder.tcc
+ * Incremental construction of a constraint system from rows in the
+ * {constraint_id, variable_id, value} layout written by the Rust side.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <libsnark/relations/constraint_satisfaction_problems/r1cs/r1cs.hpp>
+
+#include "constraint_stream.hpp"
+#include "util.tcc"
+
+template<mp_size_t R, typename FieldT>
+class r1cs_builder {
+  public:
+    r1cs_builder(int constraints, int variables, int inputs) : expected_constraints(constraints)
+    {
+      cs.primary_input_size = inputs;
+      cs.auxiliary_input_size = variables - inputs - 1; // ~one not included
+      cs.constraints.reserve(constraints);
+
+      std::cout << "num variables: " << variables << std::endl;
+      std::cout << "num constraints: " << constraints << std::endl;
+      std::cout << "num inputs: " << inputs << std::endl;
+    }
+
+    // appends `rows` constraints, numbered from where the previous call stopped;
+    // fails if some terms belong to rows outside of that range. Rows are preallocated and
+    // filled in place by row range, so the result does not depend on the thread count, and
+    // each linear combination is allocated once at its exact size.
+    bool add_rows(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int rows)
+    {
+      const VariableValueMapping* A_vvmap = (const VariableValueMapping*) A;
+      const VariableValueMapping* B_vvmap = (const VariableValueMapping*) B;
+      const VariableValueMapping* C_vvmap = (const VariableValueMapping*) C;
+
+      const int first = cs.constraints.size();
+
+      std::vector<int> A_offsets, B_offsets, C_offsets;
+      if (!rowOffsets(A_vvmap, A_len, first, rows, A_offsets)
+          || !rowOffsets(B_vvmap, B_len, first, rows, B_offsets)
+          || !rowOffsets(C_vvmap, C_len, first, rows, C_offsets))
+        return false;
+
+      cs.constraints.resize(first + rows);
+
+#ifdef MULTICORE
+      #pragma omp parallel for schedule(static)
+#endif
+      for (int row = 0; row < rows; row++) {
+        libsnark::r1cs_constraint<FieldT>& constraint = cs.constraints[first + row];
+        addTerms(A_vvmap, A_offsets[row], A_offsets[row + 1], constraint.a);
+        addTerms(B_vvmap, B_offsets[row], B_offsets[row + 1], constraint.b);
+        addTerms(C_vvmap, C_offsets[row], C_offsets[row + 1], constraint.c);
+      }
+
+      return true;
+    }
+
+    bool complete() const
+    {
+      return cs.constraints.size() == expected_constraints;
+    }
+
+    libsnark::r1cs_constraint_system<FieldT>& constraint_system()
+    {
+      return cs;
+    }
+
+    // SHA-256 of rows as the Rust side hands them over, before anything is built from them: the
+    // counts, then the terms of A, B and C
+    static std::string rowsDigest(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs)
+    {
+      sha256_digest sha;
+      int64_t counts[6] = { constraints, variables, inputs, A_len, B_len, C_len };
+      sha.update(counts, sizeof(counts));
+      sha.update(A, A_len * sizeof(VariableValueMapping));
+      sha.update(B, B_len * sizeof(VariableValueMapping));
+      sha.update(C, C_len * sizeof(VariableValueMapping));
+      return sha.hex();
+    }
+
+  private:
+    struct VariableValueMapping {
+      int constraint_id;
+      int variable_id;
+      uint8_t variable_value[R*mp_limb_t_size];
+    };
+
+    // offsets[i] is the first entry of row `first + i`, offsets[rows] the end of the last row
+    static bool rowOffsets(const VariableValueMapping* vvmap, int len, int first, int rows, std::vector<int>& offsets)
+    {
+      offsets.resize(rows + 1);
+      int id = 0;
+      for (int row = 0; row < rows; row++) {
+        offsets[row] = id;
+        while (id < len && vvmap[id].constraint_id == first + row)
+          id++;
+      }
+      offsets[rows] = id;
+      return id == len;
+    }
+
+    static void addTerms(const VariableValueMapping* vvmap, int begin, int end, libsnark::linear_combination<FieldT>& lin_comb)
+    {
+      if (begin == end)
+        return;
+      lin_comb.terms.reserve(end - begin);
+      for (int id = begin; id < end; id++) {
+        libff::bigint<R> value = libsnarkBigintFromBytes<R>(vvmap[id].variable_value);
+        if (!value.is_zero())
+          lin_comb.add_term(vvmap[id].variable_id, value);
+      }
+    }
+
+    size_t expected_constraints;
+    libsnark::r1cs_constraint_system<FieldT> cs;
+};
+
+// builds the constraint system from the whole of A, B and C at once, failing as streamConstraintSystem does
+template<mp_size_t R, typename FieldT>
+bool buildConstraintSystem(const uint8_t* A, const uint8_t* B, const uint8_t* C, int A_len, int B_len, int C_len, int constraints, int variables, int inputs, libsnark::r1cs_constraint_system<FieldT>& cs)
+{
+  r1cs_builder<R, FieldT> builder(constraints, variables, inputs);
+  if (!builder.add_rows(A, B, C, A_len, B_len, C_len, constraints)) {
+    std::cerr << "constraint terms are not sorted by row" << std::endl;
+    return false;
+  }
+  if (!builder.complete()) {
+    std::cerr << "expected " << constraints << " constraints, got " << builder.constraint_system().num_constraints() << std::endl;
+    return false;
+  }
+  cs = std::move(builder.constraint_system());
+  return true;
+}
+
+// pulls every chunk out of `next_chunk`, each chunk being released by the caller as soon as it is consumed
+template<mp_size_t R, typename FieldT>
+bool streamConstraintSystem(constraint_chunk_callback next_chunk, void* state, int constraints, int variables, int inputs, libsnark::r1cs_constraint_system<FieldT>& cs)
+{
+  r1cs_builder<R, FieldT> builder(constraints, variables, inputs);
+  constraint_chunk chunk;
+  while (next_chunk(state, &chunk)) {
+    if (!builder.add_rows(chunk.A, chunk.B, chunk.C, chunk.A_len, chunk.B_len, chunk.C_len, chunk.rows)) {
+      std::cerr << "constraint terms are not sorted by row" << std::endl;
+      return false;
+    }
+  }
+  if (!builder.complete()) {
+    std::cerr << "expected " << constraints << " constraints, got " << builder.constraint_system().num_constraints() << std::endl;
+    return false;
+  }
+  cs = std::move(builder.constraint_system());
+  return true;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+/**
+ * @file setup_cache.tcc
+ * Keypairs of the circuits already set up, kept in a local store under the
+ * digest of their constraint rows as handed over by the caller, which a
+ * setup checks before building anything from them. Streamed rows are never
+ * all in memory at once, so streamed setups use the digest of the built
+ * constraint system instead. Setting up the same constraint system again
+ * copies the stored proving key, verification key and raw verification key
+ * into place instead of running the generator; the keys then share the
+ * stored keys' randomness. The store is off unless a directory is given.
+ *
+ * Setup writes its outputs under temporary names and renames them over the
+ * previous keys only once new keys are complete, stored or generated. The
+ * store holds read-only copies, never links to the outputs.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.tcc"
+#include "binary_format.tcc"
+
+// setup keys are stored in $ZOKRATES_SETUP_KEYS; the store is off when it is unset or empty,
+// and ZOKRATES_FRESH_KEYS set to anything but "" or "0" skips it for one setup
+inline std::string setupKeysDirectory()
+{
+  if (envFlag("ZOKRATES_FRESH_KEYS"))
+    return "";
+  const char* dir = getenv("ZOKRATES_SETUP_KEYS");
+  return dir == nullptr ? "" : dir;
+}
+
+// <dir>/<scheme>_<curve>_<flags>_<digest>, the keys being <entry>.pk, <entry>.vk and
+// <entry>.vk.raw; empty when the store is disabled, in which case `digest` is not called. The
+// flags tell compressed and dense keys apart.
+template<typename ppT, typename DigestF>
+std::string setupKeysEntry(binary_format_scheme scheme, DigestF digest)
+{
+  const std::string dir = setupKeysDirectory();
+  if (dir.empty())
+    return "";
+  std::stringstream name;
+  name << dir << "/" << scheme << "_" << binary_format_curve<ppT>::id << "_" << binaryFormatFlagsFromEnv()
+       << "_" << digest();
+  return name.str();
+}
+
+// the files of one setup: proving key, verification key and raw verification key
+struct setup_outputs {
+  std::string pk;
+  std::string vk;
+  std::string vk_raw;
+
+  setup_outputs(const std::string& pk_path, const std::string& vk_path)
+    : pk(pk_path), vk(vk_path), vk_raw(vk_path + ".raw")
+  {
+  }
+};
+
+// the outputs under temporary names next to the final ones
+inline setup_outputs temporarySetupOutputs(const char* pk_path, const char* vk_path)
+{
+  const std::string suffix = ".tmp." + std::to_string(getpid());
+  return setup_outputs(std::string(pk_path) + suffix, std::string(vk_path) + suffix);
+}
+
+inline void removeSetupOutputs(const setup_outputs& files)
+{
+  unlink(files.pk.c_str());
+  unlink(files.vk.c_str());
+  unlink(files.vk_raw.c_str());
+}
+
+// renames complete outputs over the previous ones, the proving key last
+inline bool replaceSetupOutputs(const setup_outputs& from, const setup_outputs& to)
+{
+  if (rename(from.vk.c_str(), to.vk.c_str()) == 0 && rename(from.vk_raw.c_str(), to.vk_raw.c_str()) == 0
+      && rename(from.pk.c_str(), to.pk.c_str()) == 0)
+    return true;
+  removeSetupOutputs(from);
+  return false;
+}
+
+inline bool copyFile(const std::string& from, const std::string& to)
+{
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  if (!in.is_open() || !out.is_open())
+    return false;
+  out << in.rdbuf();
+  out.flush();
+  return out.good();
+}
+
+// copies the stored keys of `entry` over the setup outputs, if there are any
+inline bool restoreSetupKeys(const std::string& entry, const char* pk_path, const char* vk_path)
+{
+  if (entry.empty() || access((entry + ".pk").c_str(), R_OK) != 0)
+    return false;
+
+  const setup_outputs stored(entry + ".pk", entry + ".vk");
+  const setup_outputs tmp = temporarySetupOutputs(pk_path, vk_path);
+  if (copyFile(stored.vk, tmp.vk) && copyFile(stored.vk_raw, tmp.vk_raw) && copyFile(stored.pk, tmp.pk)
+      && replaceSetupOutputs(tmp, setup_outputs(pk_path, vk_path))) {
+    std::cout << "reusing the keys of an identical constraint system from " << entry << std::endl;
+    return true;
+  }
+  removeSetupOutputs(tmp);
+  return false;
+}
+
+// copies new keys into the store under temporary names, makes the copies read-only and renames
+// them, the proving key last, so that a concurrent setup never finds an incomplete entry; failing
+// to store is not an error
+inline void storeSetupKeys(const std::string& entry, const setup_outputs& keys)
+{
+  if (entry.empty() || !makeDirectories(entry.substr(0, entry.rfind('/'))))
+    return;
+  const std::string suffix = ".tmp." + std::to_string(getpid());
+  const std::string files[3][2] = {
+    { keys.vk, entry + ".vk" },
+    { keys.vk_raw, entry + ".vk.raw" },
+    { keys.pk, entry + ".pk" },
+  };
+  for (const auto& file : files) {
+    const std::string tmp = file[1] + suffix;
+    if (!copyFile(file[0], tmp) || chmod(tmp.c_str(), 0444) != 0 || rename(tmp.c_str(), file[1].c_str()) != 0) {
+      unlink(tmp.c_str());
+      std::cerr << "could not store the setup keys in " << entry << std::endl;
+      return;
+    }
+  }
+}
@@ -11,12 +11,47 @@
 #include <iostream>
 #include <cassert>
 #include <iomanip>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <openssl/evp.h>
+#include <sys/stat.h>
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include <libff/algebra/fields/field_utils.hpp>
 #include "libff/algebra/curves/mnt/mnt4/mnt4_pp.hpp"
 #include "libff/algebra/curves/mnt/mnt6/mnt6_pp.hpp"
 
 using namespace std;
 
+// caps the OpenMP threads used by libsnark for the current call; 0 restores the
+// runtime default (OMP_NUM_THREADS, or one per core). No-op in single-core builds.
+inline void setThreads(int threads)
+{
+#ifdef MULTICORE
+  static const int default_threads = omp_get_max_threads();
+  omp_set_num_threads(threads > 0 ? threads : default_threads);
+#else
+  (void) threads;
+#endif
+}
+
+// hands the free pages of the heap back to the system, which glibc otherwise keeps after
+// the many small allocations of a constraint system are released
+inline void releaseFreeMemory()
+{
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+}
+
 // TODO check it (should crash when not verified)
 const mp_size_t mp_limb_t_size = 8;
 
@@ -34,126 +69,237 @@ libff::bigint<N> libsnarkBigintFromBytes(const uint8_t* _x)
   return x;
 }
 
+// "00" to "ff", the two digits of byte b at offset 2 * b
+static const char HEX_DIGIT_PAIRS[] =
+  "000102030405060708090a0b0c0d0e0f"
+  "101112131415161718191a1b1c1d1e1f"
+  "202122232425262728292a2b2c2d2e2f"
+  "303132333435363738393a3b3c3d3e3f"
+  "404142434445464748494a4b4c4d4e4f"
+  "505152535455565758595a5b5c5d5e5f"
+  "606162636465666768696a6b6c6d6e6f"
+  "707172737475767778797a7b7c7d7e7f"
+  "808182838485868788898a8b8c8d8e8f"
+  "909192939495969798999a9b9c9d9e9f"
+  "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+  "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+  "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+  "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+  "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+  "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+// number of characters of a "0x"-prefixed N-limb hex number
 template<mp_size_t N>
-std::string HexStringFromLibsnarkBigint(libff::bigint<N> _x) {
-  uint8_t x[mp_limb_t_size * N];
-  for (unsigned i = 0; i < N; i++)
-    for (unsigned j = 0; j < 8; j++)
-      x[i * 8 + j] = uint8_t(uint64_t(_x.data[N - 1 - i]) >> (8 * (7 - j)));
+constexpr size_t hexLength()
+{
+  return 2 + 2 * mp_limb_t_size * N;
+}
 
-  std::stringstream ss;
-  ss << std::setfill('0');
-  for (unsigned i = 0; i<mp_limb_t_size * N; i++) {
-    ss << std::hex << std::setw(2) << (int)x[i];
+// writes the 2 * 8 * N digits of x, most significant byte first, and returns the end
+template<mp_size_t N>
+char* writeHexDigits(char* out, const libff::bigint<N>& x)
+{
+  for (mp_size_t i = N; i-- > 0; ) {
+    const uint64_t limb = x.data[i];
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      memcpy(out, HEX_DIGIT_PAIRS + 2 * ((limb >> shift) & 0xff), 2);
+      out += 2;
+    }
   }
-  return ss.str();
+  return out;
+}
+
+template<mp_size_t N>
+std::string HexStringFromLibsnarkBigint(libff::bigint<N> _x) {
+  std::string s(2 * mp_limb_t_size * N, '0');
+  writeHexDigits<N>(&s[0], _x);
+  return s;
+}
+
+// text appended in place to a buffer reserved up front, so a whole vk or proof
+// file is built with one allocation when the capacity estimate holds
+class text_buffer {
+  public:
+    explicit text_buffer(size_t capacity)
+    {
+      text.reserve(capacity);
+    }
+
+    text_buffer& operator<<(const char* s)
+    {
+      text.append(s);
+      return *this;
+    }
+
+    text_buffer& operator<<(const std::string& s)
+    {
+      text.append(s);
+      return *this;
+    }
+
+    text_buffer& operator<<(uint64_t n)
+    {
+      char digits[24];
+      int length = snprintf(digits, sizeof(digits), "%llu", (unsigned long long) n);
+      text.append(digits, length);
+      return *this;
+    }
+
+    // appends x as "0x" followed by its 2 * 8 * N hex digits
+    template<mp_size_t N>
+    text_buffer& hex(const libff::bigint<N>& x)
+    {
+      const size_t at = text.size();
+      text.resize(at + hexLength<N>());
+      char* out = &text[at];
+      out[0] = '0';
+      out[1] = 'x';
+      writeHexDigits<N>(out + 2, x);
+      return *this;
+    }
+
+    const std::string& str() const { return text; }
+
+    std::string take() { return std::move(text); }
+
+    bool write_to(const char* path) const
+    {
+      std::ofstream fh(path, std::ios::binary | std::ios::trunc);
+      fh.write(text.data(), text.size());
+      fh.close();
+      return !fh.fail();
+    }
+
+  private:
+    std::string text;
+};
+
+// coordinates of a point; MNT points expose them through accessors
+template<typename GT>
+auto pointX(const GT& p) -> decltype(p.X)
+{
+  return p.X;
+}
+
+template<typename GT>
+auto pointX(const GT& p) -> decltype(p.X())
+{
+  return p.X();
+}
+
+template<typename GT>
+auto pointY(const GT& p) -> decltype(p.Y)
+{
+  return p.Y;
+}
+
+template<typename GT>
+auto pointY(const GT& p) -> decltype(p.Y())
+{
+  return p.Y();
+}
+
+// "0xX, 0xY", or ["0xX", "0xY"] when json is set
+template<mp_size_t Q, typename G1T>
+void appendPointG1AffineAsHex(text_buffer& out, G1T p, bool json)
+{
+  p.to_affine_coordinates();
+  const char* q = json ? "\"" : "";
+  if (json) out << "[";
+  out << q; out.hex<Q>(pointX(p).as_bigint()); out << q << ", ";
+  out << q; out.hex<Q>(pointY(p).as_bigint()); out << q;
+  if (json) out << "]";
+}
+
+// "[0xX1, 0xX0], [0xY1, 0xY0]", or [["0xX1", "0xX0"], ["0xY1", "0xY0"]] when json is set
+template<mp_size_t Q, typename G2T>
+void appendPointG2AffineAsHex(text_buffer& out, G2T p, bool json)
+{
+  p.to_affine_coordinates();
+  const auto x = pointX(p);
+  const auto y = pointY(p);
+  const char* q = json ? "\"" : "";
+  if (json) out << "[";
+  out << "[" << q; out.hex<Q>(x.c1.as_bigint()); out << q << ", " << q; out.hex<Q>(x.c0.as_bigint()); out << q << "], ";
+  out << "[" << q; out.hex<Q>(y.c1.as_bigint()); out << q << ", " << q; out.hex<Q>(y.c0.as_bigint()); out << q << "]";
+  if (json) out << "]";
 }
 
 template<mp_size_t N>
 std::string outputInputAsHex(libff::bigint<N> _x){
-  return "\"0x" + HexStringFromLibsnarkBigint<N>(_x) + "\"";
+  text_buffer out(hexLength<N>() + 2);
+  out << "\"";
+  out.hex<N>(_x);
+  out << "\"";
+  return out.take();
 }
 
 template<mp_size_t Q, typename G1T>
 std::string outputPointG1AffineAsHex(G1T _p)
 {
-  G1T aff = _p;
-  aff.to_affine_coordinates();
-  if constexpr (std::is_same<G1T, libff::mnt4_G1>::value || std::is_same<G1T, libff::mnt6_G1>::value) {
-    return
-      "0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X().as_bigint()) +
-      ", 0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y().as_bigint());
-  } else {
-    return
-      "0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X.as_bigint()) +
-      ", 0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y.as_bigint());
-  }
+  text_buffer out(2 * hexLength<Q>() + 2);
+  appendPointG1AffineAsHex<Q, G1T>(out, _p, false);
+  return out.take();
 }
 
 template<mp_size_t Q, typename G1T>
 std::string outputPointG1AffineAsHexJson(G1T _p)
 {
-  G1T aff = _p;
-  aff.to_affine_coordinates();
-  if constexpr (std::is_same<G1T, libff::mnt4_G1>::value || std::is_same<G1T, libff::mnt6_G1>::value) {
-    return
-      "[\"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X().as_bigint()) +
-      "\", \"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y().as_bigint())+"\"]";
-  } else {
-    return
-      "[\"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X.as_bigint()) +
-      "\", \"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y.as_bigint())+"\"]";
-  }
+  text_buffer out(2 * hexLength<Q>() + 8);
+  appendPointG1AffineAsHex<Q, G1T>(out, _p, true);
+  return out.take();
 }
 
 template<mp_size_t Q, typename G2T>
 std::string outputPointG2AffineAsHex(G2T _p)
 {
-  G2T aff = _p;
-  aff.to_affine_coordinates();
-  if constexpr (std::is_same<G2T, libff::mnt4_G2>::value || std::is_same<G2T, libff::mnt6_G2>::value) {
-    return
-      "[0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X().c1.as_bigint()) + ", 0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X().c0.as_bigint()) + "], [0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y().c1.as_bigint()) + ", 0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y().c0.as_bigint()) + "]";
-  } else {
-    return
-      "[0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X.c1.as_bigint()) + ", 0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X.c0.as_bigint()) + "], [0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y.c1.as_bigint()) + ", 0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y.c0.as_bigint()) + "]";
-  }
+  text_buffer out(4 * hexLength<Q>() + 12);
+  appendPointG2AffineAsHex<Q, G2T>(out, _p, false);
+  return out.take();
 }
 
 template<mp_size_t Q, typename G2T>
 std::string outputPointG2AffineAsHexJson(G2T _p)
 {
-  G2T aff = _p;
-  aff.to_affine_coordinates();
-  if constexpr (std::is_same<G2T, libff::mnt4_G2>::value || std::is_same<G2T, libff::mnt6_G2>::value) {
-    return
-      "[[\"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X().c1.as_bigint()) + "\", \"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X().c0.as_bigint()) + "\"], [\"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y().c1.as_bigint()) + "\", \"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y().c0.as_bigint()) + "\"]]";
-  } else {
-    return
-      "[[\"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X.c1.as_bigint()) + "\", \"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.X.c0.as_bigint()) + "\"], [\"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y.c1.as_bigint()) + "\", \"0x" +
-      HexStringFromLibsnarkBigint<Q>(aff.Y.c0.as_bigint()) + "\"]]";
-  }
+  text_buffer out(4 * hexLength<Q>() + 24);
+  appendPointG2AffineAsHex<Q, G2T>(out, _p, true);
+  return out.take();
 }
 
+// file stream writing through a buffer of its own, so that serializing a large object
+// goes straight to disk instead of through a copy of it in memory
+class buffered_file {
+  public:
+    explicit buffered_file(const std::string& path) : buffer(1 << 20)
+    {
+      fh.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+      fh.open(path, std::ios::binary | std::ios::trunc);
+    }
+
+    std::ofstream& stream() { return fh; }
+
+    bool close()
+    {
+      fh.flush();
+      bool ok = fh.good();
+      fh.close();
+      return ok;
+    }
+
+  private:
+    std::vector<char> buffer;
+    std::ofstream fh;
+};
+
 template<typename T>
-void writeVectorToFile(std::string path, std::vector<T> &v) {
-  // vector<T> to ss
-  std::stringstream ss;
-  ss << v.size() << "\n";
+bool writeVectorToFile(std::string path, const std::vector<T> &v) {
+  buffered_file file(path);
+  file.stream() << v.size() << "\n";
   for (const T& t : v)
   {
-    ss << t << OUTPUT_NEWLINE;
+    file.stream() << t << OUTPUT_NEWLINE;
   }
-  // ss to file
-  std::ofstream fh;
-  fh.open(path, std::ios::binary);
-  ss.rdbuf()->pubseekpos(0, std::ios_base::out);
-  fh << ss.rdbuf();
-  fh.flush();
-  fh.close();
+  return file.close();
 }
 
 template<typename T>
@@ -185,17 +331,10 @@ std::vector<T> loadVectorFromFile(std::string path)
 }
 
 template<typename T>
-void writeToFile(std::string path, T& obj) {
-  // T to ss
-  std::stringstream ss;
-  ss << obj;
-  // ss to file
-  std::ofstream fh;
-  fh.open(path, std::ios::binary);
-  ss.rdbuf()->pubseekpos(0, std::ios_base::out);
-  fh << ss.rdbuf();
-  fh.flush();
-  fh.close();
+bool writeToFile(std::string path, const T& obj) {
+  buffered_file file(path);
+  file.stream() << obj;
+  return file.close();
 }
 
 template<typename T>
@@ -212,3 +351,53 @@ T loadFromFile(std::string path) {
   ss >> obj;
   return obj;
 }
+
+// mkdir -p
+inline bool makeDirectories(const std::string& path)
+{
+  for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+    std::string prefix = path.substr(0, pos);
+    if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+    if (pos == std::string::npos)
+      return true;
+  }
+}
+
+// incremental SHA-256, hex encoded on completion
+class sha256_digest {
+  public:
+    sha256_digest() : ctx(EVP_MD_CTX_new())
+    {
+      EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+    }
+
+    ~sha256_digest()
+    {
+      EVP_MD_CTX_free(ctx);
+    }
+
+    sha256_digest(const sha256_digest&) = delete;
+    sha256_digest& operator=(const sha256_digest&) = delete;
+
+    void update(const void* data, size_t size)
+    {
+      EVP_DigestUpdate(ctx, data, size);
+    }
+
+    std::string hex()
+    {
+      unsigned char md[EVP_MAX_MD_SIZE];
+      unsigned int md_len;
+      EVP_DigestFinal_ex(ctx, md, &md_len);
+      std::stringstream ss;
+      ss << std::setfill('0');
+      for (unsigned int i = 0; i < md_len; i++) {
+        ss << std::hex << std::setw(2) << (int)md[i];
+      }
+      return ss.str();
+    }
+
+  private:
+    EVP_MD_CTX* ctx;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+/**
+ * @file witness.tcc
+ * Witness handed over by the Rust side, split into the primary and auxiliary
+ * inputs of the provers. Both layouts start with `~one`, which is dropped.
+ */
+
+#include <vector>
+#include <libsnark/relations/constraint_satisfaction_problems/r1cs/r1cs.hpp>
+
+#include "util.tcc"
+
+// big-endian R * 8 byte values, public variables and private variables in separate buffers
+template<mp_size_t R, typename FieldT>
+void witnessFromBytes(const uint8_t* public_inputs, int public_inputs_length, const uint8_t* private_inputs, int private_inputs_length,
+    libsnark::r1cs_primary_input<FieldT>& primary_input, libsnark::r1cs_auxiliary_input<FieldT>& auxiliary_input)
+{
+  primary_input.resize(public_inputs_length - 1);
+  auxiliary_input.resize(private_inputs_length);
+
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(static)
+#endif
+  for (int i = 1; i < public_inputs_length; i++)
+    primary_input[i - 1] = FieldT(libsnarkBigintFromBytes<R>(public_inputs + i*R*mp_limb_t_size));
+
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < private_inputs_length; i++)
+    auxiliary_input[i] = FieldT(libsnarkBigintFromBytes<R>(private_inputs + i*R*mp_limb_t_size));
+}
+
+// R little-endian 64-bit limbs per variable, all `variables` of them in one caller-owned buffer
+// with the `public_inputs_length` public ones first. Each value is replaced by its Montgomery
+// form in place, in parallel, and the buffer is then copied once into the two vectors, which
+// are allocated at their final size.
+template<mp_size_t R, typename FieldT>
+void witnessFromLimbs(uint64_t* witness, int public_inputs_length, int variables,
+    libsnark::r1cs_primary_input<FieldT>& primary_input, libsnark::r1cs_auxiliary_input<FieldT>& auxiliary_input)
+{
+  static_assert(sizeof(FieldT) == R * sizeof(uint64_t), "field elements must be stored as their R limbs");
+  static_assert(sizeof(mp_limb_t) == sizeof(uint64_t), "limbs must be 64 bits");
+
+#ifdef MULTICORE
+  #pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < variables; i++) {
+    libff::bigint<R> value;
+    memcpy(value.data, witness + i * R, sizeof(value.data));
+    const FieldT element(value);
+    memcpy(witness + i * R, &element, sizeof(FieldT));
+  }
+
+  const FieldT* elements = (const FieldT*) witness;
+  primary_input.assign(elements + 1, elements + public_inputs_length);
+  auxiliary_input.assign(elements + public_inputs_length, elements + variables);
+}
@@ -1,7 +1,8 @@
 use crate::flat_absy::flat_variable::FlatVariable;
-use crate::helpers::Executable;
-use crate::ir::{LinComb, Prog, QuadComb, Statement, Witness};
-use std::collections::BTreeMap;
+use crate::helpers::{Executable, Helper};
+use crate::ir::{provide_variable_idx, variable_indices, variable_list};
+use crate::ir::{LinComb, Prog, Statement, Witness};
+use std::collections::HashMap;
 use std::fmt;
 use zokrates_field::field::Field;
 
@@ -9,87 +10,271 @@ pub type ExecutionResult<T> = Result<Witness<T>, Error>;
 
 impl<T: Field> Prog<T> {
     pub fn execute<U: Into<T> + Clone>(&self, inputs: &Vec<U>) -> ExecutionResult<T> {
-        let main = &self.main;
-        self.check_inputs(&inputs)?;
-        let mut witness = BTreeMap::new();
-        witness.insert(FlatVariable::one(), T::one());
-        for (arg, value) in main.arguments.iter().zip(inputs.iter()) {
-            witness.insert(arg.clone(), value.clone().into());
+        let solver = Solver::new(self);
+        let values = solver.solve(inputs)?;
+        Ok(solver.witness(&values))
+    }
+}
+
+/// Range of `Solver::terms` holding one linear combination
+#[derive(Clone, Copy, Debug)]
+struct Terms {
+    start: usize,
+    end: usize,
+}
+
+#[derive(Debug)]
+enum Instruction {
+    /// `slot = left * right`
+    Assign {
+        left: Terms,
+        right: Terms,
+        slot: usize,
+    },
+    /// `left * right == lin`
+    Check {
+        left: Terms,
+        right: Terms,
+        lin: Terms,
+    },
+    /// `outputs = helper(inputs)`, `inputs` being a range of `Solver::directive_inputs` and
+    /// `outputs` one of `Solver::directive_outputs`
+    Directive {
+        helper: Helper,
+        inputs: (usize, usize),
+        outputs: (usize, usize),
+    },
+    /// a variable read before anything defines it
+    Undefined(FlatVariable),
+}
+
+/// `main` compiled once into instructions over dense variable slots. Slot `i` holds the
+/// variable of index `i` in the R1CS, as `variable_indices` numbers them, so the leading values
+/// of a solution, one per R1CS variable, are the witness in the layout of the libsnark backends;
+/// the variables no constraint uses, such as unused private arguments, come after them.
+///
+/// Solving evaluates each linear combination straight from the slots of its terms, without
+/// looking variables up or collecting the terms.
+#[derive(Debug)]
+pub struct Solver<T: Field> {
+    variables: Vec<FlatVariable>,
+    defined: Vec<bool>,
+    #[cfg(test)]
+    r1cs_count: usize,
+    arguments: Vec<usize>,
+    terms: Vec<(usize, T)>,
+    directive_inputs: Vec<Terms>,
+    directive_outputs: Vec<usize>,
+    instructions: Vec<Instruction>,
+}
+
+impl<T: Field> Solver<T> {
+    pub fn new(prog: &Prog<T>) -> Self {
+        let (mut slots, _) = variable_indices(prog);
+        let mut solver = Solver {
+            variables: vec![],
+            defined: vec![false; slots.len()],
+            #[cfg(test)]
+            r1cs_count: slots.len(),
+            arguments: vec![],
+            terms: vec![],
+            directive_inputs: vec![],
+            directive_outputs: vec![],
+            instructions: vec![],
+        };
+
+        solver.define(&mut slots, &FlatVariable::one());
+        let mut arguments = vec![];
+        for argument in &prog.main.arguments {
+            arguments.push(solver.define(&mut slots, argument));
+        }
+        solver.arguments = arguments;
+
+        // the variables an execution defines do not depend on the inputs, so whether a
+        // constraint assigns its right-hand side is known here, once
+        for statement in &prog.main.statements {
+            match solver.compile(&mut slots, statement) {
+                Ok(instruction) => solver.instructions.push(instruction),
+                Err(variable) => {
+                    solver.instructions.push(Instruction::Undefined(variable));
+                    break;
+                }
+            }
         }
 
-        for statement in &main.statements {
-            match statement {
-                Statement::Constraint(quad, lin) => match lin.is_assignee(&witness) {
-                    true => {
-                        let val = quad.evaluate(&witness).unwrap();
-                        witness.insert(lin.0.iter().next().unwrap().0.clone(), val);
+        solver.variables = variable_list(slots);
+        solver
+    }
+
+    /// The R1CS variables, in order
+    #[cfg(test)]
+    fn variables(&self) -> &[FlatVariable] {
+        &self.variables[..self.r1cs_count]
+    }
+
+    /// The value of every slot, or the first constraint that does not hold
+    pub fn solve<U: Into<T> + Clone>(&self, inputs: &[U]) -> Result<Vec<T>, Error> {
+        if self.arguments.len() != inputs.len() {
+            return Err(Error::WrongInputCount {
+                expected: self.arguments.len(),
+                received: inputs.len(),
+            });
+        }
+
+        let mut values = vec![T::zero(); self.variables.len()];
+        values[0] = T::one();
+        for (slot, value) in self.arguments.iter().zip(inputs.iter()) {
+            values[*slot] = value.clone().into();
+        }
+
+        let mut helper_inputs = vec![];
+        for instruction in &self.instructions {
+            match instruction {
+                Instruction::Assign { left, right, slot } => {
+                    values[*slot] = self.evaluate(*left, &values) * self.evaluate(*right, &values);
+                }
+                Instruction::Check { left, right, lin } => {
+                    let lhs_value = self.evaluate(*left, &values) * self.evaluate(*right, &values);
+                    let rhs_value = self.evaluate(*lin, &values);
+                    if lhs_value != rhs_value {
+                        return Err(Error::UnsatisfiedConstraint {
+                            left: lhs_value.to_dec_string(),
+                            right: rhs_value.to_dec_string(),
+                        });
                     }
-                    false => {
-                        let lhs_value = quad.evaluate(&witness).unwrap();
-                        let rhs_value = lin.evaluate(&witness).unwrap();
-                        if lhs_value != rhs_value {
-                            return Err(Error::UnsatisfiedConstraint {
-                                left: lhs_value.to_dec_string(),
-                                right: rhs_value.to_dec_string(),
-                            });
-                        }
+                }
+                Instruction::Directive {
+                    helper,
+                    inputs,
+                    outputs,
+                } => {
+                    helper_inputs.clear();
+                    for terms in &self.directive_inputs[inputs.0..inputs.1] {
+                        helper_inputs.push(self.evaluate(*terms, &values));
                     }
-                },
-                Statement::Directive(ref d) => {
-                    let input_values: Vec<T> = d
-                        .inputs
+                    let res = helper.execute(&helper_inputs).map_err(|_| Error::Solver)?;
+                    for (slot, value) in self.directive_outputs[outputs.0..outputs.1]
                         .iter()
-                        .map(|i| i.evaluate(&witness).unwrap())
-                        .collect();
-                    match d.helper.execute(&input_values) {
-                        Ok(res) => {
-                            for (i, o) in d.outputs.iter().enumerate() {
-                                witness.insert(o.clone(), res[i].clone());
-                            }
-                            continue;
-                        }
-                        Err(_) => return Err(Error::Solver),
-                    };
+                        .zip(res.into_iter())
+                    {
+                        values[*slot] = value;
+                    }
+                }
+                Instruction::Undefined(variable) => {
+                    panic!("{} is read before it is defined", variable)
                 }
             }
         }
 
-        Ok(Witness(witness))
+        Ok(values)
     }
 
-    fn check_inputs<U>(&self, inputs: &Vec<U>) -> Result<(), Error> {
-        if self.main.arguments.len() == inputs.len() {
-            Ok(())
-        } else {
-            Err(Error::WrongInputCount {
-                expected: self.main.arguments.len(),
-                received: inputs.len(),
+    /// The defined variables of a solution and their values
+    pub fn witness(&self, values: &[T]) -> Witness<T> {
+        Witness(
+            self.variables
+                .iter()
+                .zip(values.iter())
+                .zip(self.defined.iter())
+                .filter(|(_, defined)| **defined)
+                .map(|((variable, value), _)| (*variable, value.clone()))
+                .collect(),
+        )
+    }
+
+    fn evaluate(&self, terms: Terms, values: &[T]) -> T {
+        self.terms[terms.start..terms.end]
+            .iter()
+            .fold(T::zero(), |acc, (slot, coefficient)| {
+                acc + values[*slot].clone() * coefficient
             })
+    }
+
+    fn define(
+        &mut self,
+        slots: &mut HashMap<FlatVariable, usize>,
+        variable: &FlatVariable,
+    ) -> usize {
+        let slot = provide_variable_idx(slots, variable);
+        if slot == self.defined.len() {
+            self.defined.push(false);
         }
+        self.defined[slot] = true;
+        slot
     }
-}
 
-impl<T: Field> LinComb<T> {
-    fn evaluate(&self, witness: &BTreeMap<FlatVariable, T>) -> Result<T, ()> {
-        self.0
-            .iter()
-            .map(|(var, mult)| witness.get(var).map(|v| v.clone() * mult).ok_or(())) // get each term
-            .collect::<Result<Vec<_>, _>>() // fail if any term isn't found
-            .map(|v| v.iter().fold(T::from(0), |acc, t| acc + t)) // return the sum
+    fn is_defined(&self, slots: &HashMap<FlatVariable, usize>, variable: &FlatVariable) -> bool {
+        slots
+            .get(variable)
+            .map(|slot| self.defined[*slot])
+            .unwrap_or(false)
     }
 
-    fn is_assignee<U>(&self, witness: &BTreeMap<FlatVariable, U>) -> bool {
-        self.0.iter().count() == 1
-            && self.0.iter().next().unwrap().1 == T::from(1)
-            && !witness.contains_key(&self.0.iter().next().unwrap().0)
+    /// Appends the terms of `lin`, or returns the first of its variables that is not defined yet
+    fn push_terms(
+        &mut self,
+        slots: &HashMap<FlatVariable, usize>,
+        lin: &LinComb<T>,
+    ) -> Result<Terms, FlatVariable> {
+        let start = self.terms.len();
+        for (variable, coefficient) in &lin.0 {
+            match slots.get(variable) {
+                Some(slot) if self.defined[*slot] => self.terms.push((*slot, coefficient.clone())),
+                _ => return Err(*variable),
+            }
+        }
+        Ok(Terms {
+            start,
+            end: self.terms.len(),
+        })
     }
-}
 
-impl<T: Field> QuadComb<T> {
-    pub fn evaluate(&self, witness: &BTreeMap<FlatVariable, T>) -> Result<T, ()> {
-        let left = self.left.evaluate(&witness)?;
-        let right = self.right.evaluate(&witness)?;
-        Ok(left * right)
+    fn compile(
+        &mut self,
+        slots: &mut HashMap<FlatVariable, usize>,
+        statement: &Statement<T>,
+    ) -> Result<Instruction, FlatVariable> {
+        match statement {
+            Statement::Constraint(quad, lin) => {
+                let left = self.push_terms(slots, &quad.left)?;
+                let right = self.push_terms(slots, &quad.right)?;
+                match lin.0.as_slice() {
+                    [(variable, coefficient)]
+                        if *coefficient == T::from(1) && !self.is_defined(slots, variable) =>
+                    {
+                        Ok(Instruction::Assign {
+                            left,
+                            right,
+                            slot: self.define(slots, variable),
+                        })
+                    }
+                    _ => Ok(Instruction::Check {
+                        left,
+                        right,
+                        lin: self.push_terms(slots, lin)?,
+                    }),
+                }
+            }
+            Statement::Directive(d) => {
+                let start = self.directive_inputs.len();
+                for input in &d.inputs {
+                    let terms = self.push_terms(slots, input)?;
+                    self.directive_inputs.push(terms);
+                }
+                let inputs = (start, self.directive_inputs.len());
+
+                let start = self.directive_outputs.len();
+                for output in &d.outputs {
+                    let slot = self.define(slots, output);
+                    self.directive_outputs.push(slot);
+                }
+                Ok(Instruction::Directive {
+                    helper: d.helper.clone(),
+                    inputs,
+                    outputs: (start, self.directive_outputs.len()),
+                })
+            }
+        }
     }
 }
 
@@ -125,3 +310,102 @@ impl fmt::Debug for Error {
         write!(f, "{}", self)
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::helpers::RustHelper;
+    use crate::ir::{Directive, Function, QuadComb};
+    use std::collections::BTreeMap;
+    use zokrates_field::field::FieldPrime;
+
+    // ~out_0 = _0 * _1, with _1 a copy of _0 made by a directive and checked; _2 is unused
+    fn square() -> Prog<FieldPrime> {
+        Prog {
+            main: Function {
+                id: String::from("main"),
+                arguments: vec![FlatVariable::new(0), FlatVariable::new(2)],
+                returns: vec![FlatVariable::public(0)],
+                statements: vec![
+                    Statement::Directive(Directive {
+                        inputs: vec![FlatVariable::new(0).into()],
+                        outputs: vec![FlatVariable::new(1)],
+                        helper: Helper::Rust(RustHelper::Identity),
+                    }),
+                    Statement::constraint(FlatVariable::new(1), FlatVariable::new(0)),
+                    Statement::definition(
+                        FlatVariable::public(0),
+                        QuadComb::from_linear_combinations(
+                            FlatVariable::new(0).into(),
+                            FlatVariable::new(1).into(),
+                        ),
+                    ),
+                ],
+            },
+            private: vec![true, true],
+        }
+    }
+
+    #[test]
+    fn solves_in_r1cs_order() {
+        let prog = square();
+        let solver = Solver::new(&prog);
+        assert_eq!(
+            solver.variables(),
+            variable_list(variable_indices(&prog).0).as_slice()
+        );
+
+        let values = solver.solve(&vec![3, 7]).unwrap();
+        let expected: BTreeMap<_, _> = vec![
+            (FlatVariable::one(), 1),
+            (FlatVariable::new(0), 3),
+            (FlatVariable::new(1), 3),
+            (FlatVariable::new(2), 7),
+            (FlatVariable::public(0), 9),
+        ]
+        .into_iter()
+        .map(|(variable, value)| (variable, FieldPrime::from(value)))
+        .collect();
+        assert_eq!(solver.witness(&values), Witness(expected.clone()));
+        assert_eq!(prog.execute(&vec![3, 7]).unwrap(), Witness(expected));
+
+        // the unused argument comes after the R1CS variables
+        assert!(!solver.variables().contains(&FlatVariable::new(2)));
+        assert_eq!(values[solver.variables().len()], FieldPrime::from(7));
+    }
+
+    #[test]
+    fn reports_unsatisfied_constraints() {
+        let prog: Prog<FieldPrime> = Prog {
+            main: Function {
+                id: String::from("main"),
+                arguments: vec![FlatVariable::new(0), FlatVariable::new(1)],
+                returns: vec![],
+                statements: vec![Statement::constraint(
+                    QuadComb::from_linear_combinations(
+                        FlatVariable::new(0).into(),
+                        FlatVariable::new(0).into(),
+                    ),
+                    FlatVariable::new(1),
+                )],
+            },
+            private: vec![false, false],
+        };
+
+        assert!(prog.execute(&vec![2, 4]).is_ok());
+        assert_eq!(
+            prog.execute(&vec![2, 5]),
+            Err(Error::UnsatisfiedConstraint {
+                left: String::from("4"),
+                right: String::from("5"),
+            })
+        );
+        assert_eq!(
+            prog.execute(&vec![2]),
+            Err(Error::WrongInputCount {
+                expected: 2,
+                received: 1,
+            })
+        );
+    }
+}
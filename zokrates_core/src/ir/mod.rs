@@ -8,12 +8,14 @@ mod expression;
 pub mod folder;
 mod from_flat;
 mod interpreter;
+mod variables;
 mod witness;
 
 use self::expression::QuadComb;
 pub use self::expression::{CanonicalLinComb, LinComb};
 
-pub use self::interpreter::{Error, ExecutionResult};
+pub use self::interpreter::{Error, ExecutionResult, Solver};
+pub use self::variables::{provide_variable_idx, variable_indices, variable_list};
 pub use self::witness::Witness;
 
 #[derive(Debug, Serialize, Deserialize, Clone, PartialEq)]
@@ -0,0 +1,75 @@
+//! Numbering of a program's variables in its R1CS, shared by the libsnark backends, which
+//! lay out constraints and witnesses in it, and by the solver, which computes the witness
+//! straight into it.
+
+use crate::flat_absy::FlatVariable;
+use crate::ir::{Prog, Statement};
+use std::collections::HashMap;
+use zokrates_field::field::Field;
+
+/// Returns the index of `var` in `variables`, adding `var` with incremented index if it not yet exists.
+///
+/// # Arguments
+///
+/// * `variables` - A mutual map that maps all existing variables to their index.
+/// * `var` - Variable to be searched for.
+pub fn provide_variable_idx(
+    variables: &mut HashMap<FlatVariable, usize>,
+    var: &FlatVariable,
+) -> usize {
+    let index = variables.len();
+    *variables.entry(*var).or_insert(index)
+}
+
+/// Assigns every variable of `prog` its index in the R1CS and returns the indices along
+/// with the number of public variables, which come first
+pub fn variable_indices<T: Field>(prog: &Prog<T>) -> (HashMap<FlatVariable, usize>, usize) {
+    let mut variables: HashMap<FlatVariable, usize> = HashMap::new();
+    provide_variable_idx(&mut variables, &FlatVariable::one());
+
+    for x in prog
+        .main
+        .arguments
+        .iter()
+        .enumerate()
+        .filter(|(index, _)| !prog.private[*index])
+    {
+        provide_variable_idx(&mut variables, &x.1);
+    }
+
+    //~out are added after main's arguments as we want variables (columns)
+    //in the r1cs to be aligned like "public inputs | private inputs"
+    for i in 0..prog.main.returns.len() {
+        provide_variable_idx(&mut variables, &FlatVariable::public(i));
+    }
+
+    // position where private part of witness starts
+    let private_inputs_offset = variables.len();
+
+    for (quad, lin) in prog.main.statements.iter().filter_map(|s| match s {
+        Statement::Constraint(quad, lin) => Some((quad, lin)),
+        Statement::Directive(..) => None,
+    }) {
+        for (k, _) in &quad.left.0 {
+            provide_variable_idx(&mut variables, &k);
+        }
+        for (k, _) in &quad.right.0 {
+            provide_variable_idx(&mut variables, &k);
+        }
+        for (k, _) in &lin.0 {
+            provide_variable_idx(&mut variables, &k);
+        }
+    }
+
+    (variables, private_inputs_offset)
+}
+
+/// Converts variable indices into the list of variables ordered by index
+pub fn variable_list(mut variables: HashMap<FlatVariable, usize>) -> Vec<FlatVariable> {
+    let mut variables_list = vec![FlatVariable::new(0); variables.len()];
+    for (k, v) in variables.drain() {
+        assert_eq!(variables_list[v], FlatVariable::new(0));
+        std::mem::replace(&mut variables_list[v], k);
+    }
+    variables_list
+}
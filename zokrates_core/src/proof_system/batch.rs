@@ -1,6 +1,7 @@
 extern crate libc;
 
-use self::libc::c_char;
+use self::libc::{c_char, c_int};
+use proof_system::threads;
 use std::ffi::CString;
 
 extern "C" {
@@ -11,6 +12,7 @@ extern "C" {
         proof_2_path: *const c_char,
         agg_vk_path: *const c_char,
         agg_proof_path: *const c_char,
+        threads: c_int,
     ) -> bool;
     fn _pghr13_mnt6_mnt4_batch(
         vk_1_path: *const c_char,
@@ -19,6 +21,25 @@ extern "C" {
         proof_2_path: *const c_char,
         agg_vk_path: *const c_char,
         agg_proof_path: *const c_char,
+        threads: c_int,
+    ) -> bool;
+    fn _pghr13_mnt4_mnt6_batch_tree(
+        vk_paths: *const *const c_char,
+        proof_paths: *const *const c_char,
+        count: c_int,
+        arity: c_int,
+        agg_vk_path: *const c_char,
+        agg_proof_path: *const c_char,
+        threads: c_int,
+    ) -> bool;
+    fn _pghr13_mnt6_mnt4_batch_tree(
+        vk_paths: *const *const c_char,
+        proof_paths: *const *const c_char,
+        count: c_int,
+        arity: c_int,
+        agg_vk_path: *const c_char,
+        agg_proof_path: *const c_char,
+        threads: c_int,
     ) -> bool;
 }
 pub fn batch(
@@ -46,6 +67,7 @@ pub fn batch(
                 proof_2_path_cstring.as_ptr(),
                 agg_vk_path_cstring.as_ptr(),
                 agg_proof_path_cstring.as_ptr(),
+                threads() as c_int,
             )
         },
         ("MNT6", "MNT4") => unsafe {
@@ -56,8 +78,112 @@ pub fn batch(
                 proof_2_path_cstring.as_ptr(),
                 agg_vk_path_cstring.as_ptr(),
                 agg_proof_path_cstring.as_ptr(),
+                threads() as c_int,
+            )
+        },
+        _ => panic!("Not supported batch"),
+    }
+}
+
+/// Aggregates all the given proofs into a single proof on `to_curve`.
+pub fn batch_n(
+    from_curve: &str,
+    to_curve: &str,
+    vk_paths: &[String],
+    proof_paths: &[String],
+    agg_vk_path: &str,
+    agg_proof_path: &str,
+) -> bool {
+    batch_tree(
+        from_curve,
+        to_curve,
+        vk_paths,
+        proof_paths,
+        vk_paths.len(),
+        agg_vk_path,
+        agg_proof_path,
+    )
+}
+
+/// Aggregates the given proofs `arity` at a time, the first layer on `to_curve` and each
+/// following layer back on the other curve, until a single proof is left. The final proof
+/// lies on `to_curve` if `tree_depth` is odd, on `from_curve` otherwise.
+pub fn batch_tree(
+    from_curve: &str,
+    to_curve: &str,
+    vk_paths: &[String],
+    proof_paths: &[String],
+    arity: usize,
+    agg_vk_path: &str,
+    agg_proof_path: &str,
+) -> bool {
+    assert_eq!(vk_paths.len(), proof_paths.len());
+    let vk_paths_cstring: Vec<CString> = vk_paths
+        .iter()
+        .map(|p| CString::new(p.as_str()).unwrap())
+        .collect();
+    let proof_paths_cstring: Vec<CString> = proof_paths
+        .iter()
+        .map(|p| CString::new(p.as_str()).unwrap())
+        .collect();
+    let vk_paths_ptr: Vec<*const c_char> = vk_paths_cstring.iter().map(|p| p.as_ptr()).collect();
+    let proof_paths_ptr: Vec<*const c_char> =
+        proof_paths_cstring.iter().map(|p| p.as_ptr()).collect();
+    let agg_vk_path_cstring = CString::new(agg_vk_path).unwrap();
+    let agg_proof_path_cstring = CString::new(agg_proof_path).unwrap();
+    match (from_curve, to_curve) {
+        ("MNT4", "MNT6") => unsafe {
+            _pghr13_mnt4_mnt6_batch_tree(
+                vk_paths_ptr.as_ptr(),
+                proof_paths_ptr.as_ptr(),
+                vk_paths_ptr.len() as c_int,
+                arity as c_int,
+                agg_vk_path_cstring.as_ptr(),
+                agg_proof_path_cstring.as_ptr(),
+                threads() as c_int,
+            )
+        },
+        ("MNT6", "MNT4") => unsafe {
+            _pghr13_mnt6_mnt4_batch_tree(
+                vk_paths_ptr.as_ptr(),
+                proof_paths_ptr.as_ptr(),
+                vk_paths_ptr.len() as c_int,
+                arity as c_int,
+                agg_vk_path_cstring.as_ptr(),
+                agg_proof_path_cstring.as_ptr(),
+                threads() as c_int,
             )
         },
         _ => panic!("Not supported batch"),
     }
 }
+
+/// Number of aggregation layers needed to fold `count` proofs `arity` at a time.
+pub fn tree_depth(count: usize, arity: usize) -> usize {
+    assert!(count > 0 && arity > 1);
+    let mut remaining = count;
+    let mut depth = 0;
+    loop {
+        remaining = (remaining + arity - 1) / arity;
+        depth += 1;
+        if remaining == 1 {
+            return depth;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn depth() {
+        assert_eq!(tree_depth(1, 2), 1);
+        assert_eq!(tree_depth(2, 2), 1);
+        assert_eq!(tree_depth(3, 2), 2);
+        assert_eq!(tree_depth(4, 2), 2);
+        assert_eq!(tree_depth(5, 2), 3);
+        assert_eq!(tree_depth(9, 3), 2);
+        assert_eq!(tree_depth(10, 3), 3);
+    }
+}
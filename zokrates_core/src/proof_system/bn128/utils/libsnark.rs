@@ -1,8 +1,14 @@
+extern crate libc;
+
+use self::libc::{c_int, c_void};
 use flat_absy::FlatVariable;
 use ir::{self, Statement};
+use proof_system::variable_map::{
+    program_hash, variable_indices, variable_list, variable_map_path, VariableMap,
+};
 use std::cmp::max;
-use std::collections::HashMap;
 use std::ffi::CString;
+use std::vec::IntoIter;
 use zokrates_field::field::Field;
 
 // utility function. Converts a Fields vector-based byte representation to fixed size array.
@@ -15,24 +21,111 @@ fn vec_as_u8_32_array(vec: &Vec<u8>) -> [u8; 32] {
     array
 }
 
+// number of constraint rows handed to the setup per chunk
+const CHUNK_ROWS: usize = 1 << 16;
+
+// Sizes in bytes of our struct {row, id, value}
+// We're building { i32, i32, i8[32] }
+const STRUCT_SIZE: usize = 40;
+
+/// Layout of a chunk of constraint rows as read by the libsnark setup
+#[repr(C)]
+pub struct ConstraintChunk {
+    a: *const u8,
+    b: *const u8,
+    c: *const u8,
+    a_len: c_int,
+    b_len: c_int,
+    c_len: c_int,
+    rows: c_int,
+}
+
+/// Hands the R1CS of a program over to the libsnark setup a chunk of rows at a time.
+/// Rows are dropped as they are packed and the packing buffers are reused, so only
+/// one chunk is ever held in the `VariableValueMapping` layout.
+pub struct ConstraintStream<T: Field> {
+    a: IntoIter<Vec<(usize, T)>>,
+    b: IntoIter<Vec<(usize, T)>>,
+    c: IntoIter<Vec<(usize, T)>>,
+    row: usize,
+    a_arr: Vec<u8>,
+    b_arr: Vec<u8>,
+    c_arr: Vec<u8>,
+}
+
+impl<T: Field> ConstraintStream<T> {
+    fn new(
+        a: Vec<Vec<(usize, T)>>,
+        b: Vec<Vec<(usize, T)>>,
+        c: Vec<Vec<(usize, T)>>,
+    ) -> ConstraintStream<T> {
+        ConstraintStream {
+            a: a.into_iter(),
+            b: b.into_iter(),
+            c: c.into_iter(),
+            row: 0,
+            a_arr: vec![],
+            b_arr: vec![],
+            c_arr: vec![],
+        }
+    }
+
+    fn next_chunk(&mut self, chunk: &mut ConstraintChunk) -> bool {
+        self.a_arr.clear();
+        self.b_arr.clear();
+        self.c_arr.clear();
+
+        let first_row = self.row;
+        while self.row - first_row < CHUNK_ROWS {
+            match (self.a.next(), self.b.next(), self.c.next()) {
+                (Some(a), Some(b), Some(c)) => {
+                    pack_row(&mut self.a_arr, self.row, a);
+                    pack_row(&mut self.b_arr, self.row, b);
+                    pack_row(&mut self.c_arr, self.row, c);
+                    self.row += 1;
+                }
+                _ => break,
+            }
+        }
+
+        *chunk = ConstraintChunk {
+            a: self.a_arr.as_ptr(),
+            b: self.b_arr.as_ptr(),
+            c: self.c_arr.as_ptr(),
+            a_len: (self.a_arr.len() / STRUCT_SIZE) as c_int,
+            b_len: (self.b_arr.len() / STRUCT_SIZE) as c_int,
+            c_len: (self.c_arr.len() / STRUCT_SIZE) as c_int,
+            rows: (self.row - first_row) as c_int,
+        };
+        self.row > first_row
+    }
+}
+
+fn pack_row<T: Field>(arr: &mut Vec<u8>, row: usize, terms: Vec<(usize, T)>) {
+    for (idx, val) in terms {
+        arr.extend_from_slice(&(row as i32).to_le_bytes());
+        arr.extend_from_slice(&(idx as i32).to_le_bytes());
+        arr.extend_from_slice(&vec_as_u8_32_array(&val.into_byte_vector()));
+    }
+}
+
+/// `constraint_chunk_callback` reading from the `ConstraintStream<T>` passed as `state`
+pub extern "C" fn next_constraint_chunk<T: Field>(
+    state: *mut c_void,
+    chunk: *mut ConstraintChunk,
+) -> bool {
+    let stream = unsafe { &mut *(state as *mut ConstraintStream<T>) };
+    stream.next_chunk(unsafe { &mut *chunk })
+}
+
 // proof-system-independent preparation for the setup phase
 pub fn prepare_setup<T: Field>(
     program: ir::Prog<T>,
     pk_path: &str,
     vk_path: &str,
-) -> (
-    Vec<u8>,
-    Vec<u8>,
-    Vec<u8>,
-    Vec<(i32, i32, [u8; 32])>,
-    Vec<(i32, i32, [u8; 32])>,
-    Vec<(i32, i32, [u8; 32])>,
-    usize,
-    usize,
-    usize,
-    CString,
-    CString,
-) {
+) -> (ConstraintStream<T>, usize, usize, usize, CString, CString) {
+    let hash = program_hash(&program);
+
     // transform to R1CS
     let (variables, public_variables_count, a, b, c) = r1cs_program(program);
 
@@ -41,92 +134,10 @@ pub fn prepare_setup<T: Field>(
     let num_constraints = a.len();
     let num_variables = variables.len();
 
-    // Create single A,B,C vectors of tuples (constraint_number, variable_id, variable_value)
-    let mut a_vec = vec![];
-    let mut b_vec = vec![];
-    let mut c_vec = vec![];
-    for row in 0..num_constraints {
-        for &(idx, ref val) in &a[row] {
-            a_vec.push((
-                row as i32,
-                idx as i32,
-                vec_as_u8_32_array(&val.into_byte_vector()),
-            ));
-        }
-        for &(idx, ref val) in &b[row] {
-            b_vec.push((
-                row as i32,
-                idx as i32,
-                vec_as_u8_32_array(&val.into_byte_vector()),
-            ));
-        }
-        for &(idx, ref val) in &c[row] {
-            c_vec.push((
-                row as i32,
-                idx as i32,
-                vec_as_u8_32_array(&val.into_byte_vector()),
-            ));
-        }
-    }
-
-    // Sizes and offsets in bytes for our struct {row, id, value}
-    // We're building { i32, i32, i8[32] }
-    const STRUCT_SIZE: usize = 40;
-
-    const ROW_SIZE: usize = 4;
-
-    const IDX_SIZE: usize = 4;
-    const IDX_OFFSET: usize = 4;
-
-    const VALUE_SIZE: usize = 32;
-    const VALUE_OFFSET: usize = 8;
-
-    // Convert above A,B,C vectors to byte arrays for cpp
-    let mut a_arr: Vec<u8> = vec![0u8; STRUCT_SIZE * a_vec.len()];
-    let mut b_arr: Vec<u8> = vec![0u8; STRUCT_SIZE * b_vec.len()];
-    let mut c_arr: Vec<u8> = vec![0u8; STRUCT_SIZE * c_vec.len()];
-    use std::mem::transmute;
-    for (id, (row, idx, val)) in a_vec.iter().enumerate() {
-        let row_bytes: [u8; ROW_SIZE] = unsafe { transmute(row.to_le()) };
-        let idx_bytes: [u8; IDX_SIZE] = unsafe { transmute(idx.to_le()) };
-
-        for x in 0..ROW_SIZE {
-            a_arr[id * STRUCT_SIZE + x] = row_bytes[x];
-        }
-        for x in 0..IDX_SIZE {
-            a_arr[id * STRUCT_SIZE + x + IDX_OFFSET] = idx_bytes[x];
-        }
-        for x in 0..VALUE_SIZE {
-            a_arr[id * STRUCT_SIZE + x + VALUE_OFFSET] = val[x];
-        }
-    }
-    for (id, (row, idx, val)) in b_vec.iter().enumerate() {
-        let row_bytes: [u8; ROW_SIZE] = unsafe { transmute(row.to_le()) };
-        let idx_bytes: [u8; IDX_SIZE] = unsafe { transmute(idx.to_le()) };
-
-        for x in 0..ROW_SIZE {
-            b_arr[id * STRUCT_SIZE + x] = row_bytes[x];
-        }
-        for x in 0..IDX_SIZE {
-            b_arr[id * STRUCT_SIZE + x + IDX_OFFSET] = idx_bytes[x];
-        }
-        for x in 0..VALUE_SIZE {
-            b_arr[id * STRUCT_SIZE + x + VALUE_OFFSET] = val[x];
-        }
-    }
-    for (id, (row, idx, val)) in c_vec.iter().enumerate() {
-        let row_bytes: [u8; ROW_SIZE] = unsafe { transmute(row.to_le()) };
-        let idx_bytes: [u8; IDX_SIZE] = unsafe { transmute(idx.to_le()) };
-
-        for x in 0..ROW_SIZE {
-            c_arr[id * STRUCT_SIZE + x] = row_bytes[x];
-        }
-        for x in 0..IDX_SIZE {
-            c_arr[id * STRUCT_SIZE + x + IDX_OFFSET] = idx_bytes[x];
-        }
-        for x in 0..VALUE_SIZE {
-            c_arr[id * STRUCT_SIZE + x + VALUE_OFFSET] = val[x];
-        }
+    // keep the variable order next to the keys so proving does not have to rebuild the R1CS
+    let map = VariableMap::from_variables(hash, variables, public_variables_count);
+    if let Err(e) = map.write(&variable_map_path(pk_path)) {
+        eprintln!("could not write variable map next to {}: {}", pk_path, e);
     }
 
     // convert String slices to 'CString's
@@ -134,12 +145,7 @@ pub fn prepare_setup<T: Field>(
     let vk_path_cstring = CString::new(vk_path).unwrap();
 
     (
-        a_arr,
-        b_arr,
-        c_arr,
-        a_vec,
-        b_vec,
-        c_vec,
+        ConstraintStream::new(a, b, c),
         num_constraints,
         num_variables,
         num_inputs,
@@ -148,9 +154,11 @@ pub fn prepare_setup<T: Field>(
     )
 }
 
-// proof-system-independent preparation for proof generation
+// proof-system-independent preparation for proof generation, for a program hashing to
+// `program_hash`
 pub fn prepare_generate_proof<T: Field>(
-    program: ir::Prog<T>,
+    program: &ir::Prog<T>,
+    program_hash: u64,
     witness: ir::Witness<T>,
     pk_path: &str,
     proof_path: &str,
@@ -158,27 +166,27 @@ pub fn prepare_generate_proof<T: Field>(
     let pk_path_cstring = CString::new(pk_path).unwrap();
     let proof_path_cstring = CString::new(proof_path).unwrap();
 
-    // recover variable order from the program
-    let (variables, public_variables_count, _, _, _) = r1cs_program(program);
-    let witness: Vec<_> = variables.iter().map(|x| witness.0[x].clone()).collect();
+    // variable order as written by setup, derived again if the program changed since
+    let map = VariableMap::load_or_derive_hashed(pk_path, program, program_hash);
 
-    // split witness into public and private inputs at offset
-    let mut public_inputs: Vec<_> = witness.clone();
-    let private_inputs: Vec<_> = public_inputs.split_off(public_variables_count);
+    let public_inputs_length = map.public_count;
+    let private_inputs_length = map.variables.len() - map.public_count;
 
-    let public_inputs_length = public_inputs.len();
-    let private_inputs_length = private_inputs.len();
-
-    let mut public_inputs_arr: Vec<[u8; 32]> = vec![[0u8; 32]; public_inputs_length];
-    // length must not be zero here, so we apply the max function
-    let mut private_inputs_arr: Vec<[u8; 32]> = vec![[0u8; 32]; max(private_inputs_length, 1)];
+    let mut public_inputs_arr: Vec<[u8; 32]> = Vec::with_capacity(public_inputs_length);
+    let mut private_inputs_arr: Vec<[u8; 32]> = Vec::with_capacity(max(private_inputs_length, 1));
 
     //convert inputs
-    for (index, value) in public_inputs.into_iter().enumerate() {
-        public_inputs_arr[index] = vec_as_u8_32_array(&value.into_byte_vector());
+    for (index, variable) in map.variables.iter().enumerate() {
+        let value = vec_as_u8_32_array(&witness.0[variable].into_byte_vector());
+        if index < public_inputs_length {
+            public_inputs_arr.push(value);
+        } else {
+            private_inputs_arr.push(value);
+        }
     }
-    for (index, value) in private_inputs.into_iter().enumerate() {
-        private_inputs_arr[index] = vec_as_u8_32_array(&value.into_byte_vector());
+    // length must not be zero here
+    if private_inputs_arr.is_empty() {
+        private_inputs_arr.push([0u8; 32]);
     }
 
     (
@@ -191,18 +199,78 @@ pub fn prepare_generate_proof<T: Field>(
     )
 }
 
-/// Returns the index of `var` in `variables`, adding `var` with incremented index if it not yet exists.
-///
-/// # Arguments
-///
-/// * `variables` - A mutual map that maps all existing variables to their index.
-/// * `var` - Variable to be searched for.
-pub fn provide_variable_idx(
-    variables: &mut HashMap<FlatVariable, usize>,
-    var: &FlatVariable,
-) -> usize {
-    let index = variables.len();
-    *variables.entry(*var).or_insert(index)
+// 64-bit limbs per value in the witness layout of `_*_generate_proof_limbs`
+const WITNESS_LIMBS: usize = 4;
+
+/// Proof-system-independent preparation for proof generation from a limb buffer: every
+/// variable in constraint-system order, public ones first, as little-endian 64-bit limbs.
+/// Returns the buffer along with the number of public variables and of all variables.
+pub fn prepare_witness_limbs<T: Field>(
+    program: ir::Prog<T>,
+    witness: ir::Witness<T>,
+    pk_path: &str,
+    proof_path: &str,
+) -> (CString, CString, Vec<u64>, usize, usize) {
+    let pk_path_cstring = CString::new(pk_path).unwrap();
+    let proof_path_cstring = CString::new(proof_path).unwrap();
+
+    let map = VariableMap::load_or_derive(pk_path, &program);
+    let limbs = witness_limbs(&map, &witness);
+
+    (
+        pk_path_cstring,
+        proof_path_cstring,
+        limbs,
+        map.public_count,
+        map.variables.len(),
+    )
+}
+
+/// Same as `prepare_witness_limbs` for several witnesses of one program, proven against one key
+pub fn prepare_witnesses_limbs<T: Field>(
+    program: ir::Prog<T>,
+    witnesses: Vec<ir::Witness<T>>,
+    pk_path: &str,
+    proof_paths: &[String],
+) -> (CString, Vec<CString>, Vec<Vec<u64>>, usize, usize) {
+    let pk_path_cstring = CString::new(pk_path).unwrap();
+    let proof_paths_cstring = proof_paths
+        .iter()
+        .map(|p| CString::new(p.as_str()).unwrap())
+        .collect();
+
+    let map = VariableMap::load_or_derive(pk_path, &program);
+    let limbs = witnesses
+        .iter()
+        .map(|witness| witness_limbs(&map, witness))
+        .collect();
+
+    (
+        pk_path_cstring,
+        proof_paths_cstring,
+        limbs,
+        map.public_count,
+        map.variables.len(),
+    )
+}
+
+fn witness_limbs<T: Field>(map: &VariableMap, witness: &ir::Witness<T>) -> Vec<u64> {
+    let mut limbs = vec![0u64; map.variables.len() * WITNESS_LIMBS];
+    for (value, variable) in limbs.chunks_mut(WITNESS_LIMBS).zip(map.variables.iter()) {
+        write_limbs(&witness.0[variable], value);
+    }
+    limbs
+}
+
+// writes `value` to `out` as little-endian 64-bit limbs
+fn write_limbs<T: Field>(value: &T, out: &mut [u64]) {
+    for limb in out.iter_mut() {
+        *limb = 0;
+    }
+    // into_byte_vector is little-endian
+    for (index, byte) in value.into_byte_vector().iter().enumerate() {
+        out[index / 8] |= (*byte as u64) << (8 * (index % 8));
+    }
 }
 
 /// Calculates one R1CS row representation of a program and returns (V, A, B, C) so that:
@@ -221,49 +289,11 @@ pub fn r1cs_program<T: Field>(
     Vec<Vec<(usize, T)>>,
     Vec<Vec<(usize, T)>>,
 ) {
-    let mut variables: HashMap<FlatVariable, usize> = HashMap::new();
-    provide_variable_idx(&mut variables, &FlatVariable::one());
-
-    for x in prog
-        .main
-        .arguments
-        .iter()
-        .enumerate()
-        .filter(|(index, _)| !prog.private[*index])
-    {
-        provide_variable_idx(&mut variables, &x.1);
-    }
+    let (variables, private_inputs_offset) = variable_indices(&prog);
 
     //Only the main function is relevant in this step, since all calls to other functions were resolved during flattening
     let main = prog.main;
 
-    //~out are added after main's arguments as we want variables (columns)
-    //in the r1cs to be aligned like "public inputs | private inputs"
-    let main_return_count = main.returns.len();
-
-    for i in 0..main_return_count {
-        provide_variable_idx(&mut variables, &FlatVariable::public(i));
-    }
-
-    // position where private part of witness starts
-    let private_inputs_offset = variables.len();
-
-    // first pass through statements to populate `variables`
-    for (quad, lin) in main.statements.iter().filter_map(|s| match s {
-        Statement::Constraint(quad, lin) => Some((quad, lin)),
-        Statement::Directive(..) => None,
-    }) {
-        for (k, _) in &quad.left.0 {
-            provide_variable_idx(&mut variables, &k);
-        }
-        for (k, _) in &quad.right.0 {
-            provide_variable_idx(&mut variables, &k);
-        }
-        for (k, _) in &lin.0 {
-            provide_variable_idx(&mut variables, &k);
-        }
-    }
-
     let mut a = vec![];
     let mut b = vec![];
     let mut c = vec![];
@@ -295,11 +325,5 @@ pub fn r1cs_program<T: Field>(
         );
     }
 
-    // Convert map back into list ordered by index
-    let mut variables_list = vec![FlatVariable::new(0); variables.len()];
-    for (k, v) in variables.drain() {
-        assert_eq!(variables_list[v], FlatVariable::new(0));
-        std::mem::replace(&mut variables_list[v], k);
-    }
-    (variables_list, private_inputs_offset, a, b, c)
+    (variable_list(variables), private_inputs_offset, a, b, c)
 }
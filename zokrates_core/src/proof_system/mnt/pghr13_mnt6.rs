@@ -1,10 +1,13 @@
 extern crate libc;
 
 use std::ffi::CString;
-use self::libc::{c_char, c_int};
+use self::libc::{c_char, c_int, c_void};
 use ir;
-use proof_system::mnt::utils::libsnark::{prepare_setup, prepare_generate_proof};
-use proof_system::ProofSystem;
+use proof_system::mnt::utils::libsnark::{
+    next_constraint_chunk, prepare_generate_proof, prepare_setup, prepare_witness_limbs,
+    prepare_witnesses_limbs, ConstraintChunk, ConstraintStream,
+};
+use proof_system::{threads, ProofSystem, ProverContext};
 
 use std::fs::File;
 use std::io::BufReader;
@@ -12,18 +15,15 @@ use std::io::BufReader;
 use zokrates_field::field::FieldPrime;
 
 extern "C" {
-    fn _pghr13_mnt6_setup(
-        A: *const u8,
-        B: *const u8,
-        C: *const u8,
-        A_len: c_int,
-        B_len: c_int,
-        C_len: c_int,
+    fn _pghr13_mnt6_setup_streamed(
+        next_chunk: extern "C" fn(*mut c_void, *mut ConstraintChunk) -> bool,
+        state: *mut c_void,
         constraints: c_int,
         variables: c_int,
         inputs: c_int,
         pk_path: *const c_char,
         vk_path: *const c_char,
+        threads: c_int,
     ) -> bool;
 
     fn _pghr13_mnt6_generate_proof(
@@ -33,12 +33,62 @@ extern "C" {
         public_inputs_length: c_int,
         private_inputs: *const u8,
         private_inputs_length: c_int,
+        threads: c_int,
+    ) -> bool;
+
+    fn _pghr13_mnt6_generate_proof_limbs(
+        pk_path: *const c_char,
+        proof_path: *const c_char,
+        witness: *mut u64,
+        public_inputs_length: c_int,
+        variables: c_int,
+        threads: c_int,
+    ) -> bool;
+
+    fn _pghr13_mnt6_generate_proofs_limbs(
+        pk_path: *const c_char,
+        proof_paths: *const *const c_char,
+        witnesses: *const *mut u64,
+        count: c_int,
+        public_inputs_length: c_int,
+        variables: c_int,
+        results: *mut bool,
+        threads: c_int,
     ) -> bool;
 
     fn _pghr13_mnt6_verify_proof(
         vk_path: *const c_char,
         proof_path: *const c_char,
     ) -> bool;
+
+    fn _pghr13_mnt6_verify_proofs(
+        vk_path: *const c_char,
+        proof_paths: *const *const c_char,
+        count: c_int,
+        results: *mut bool,
+        threads: c_int,
+    ) -> bool;
+
+    fn _pghr13_mnt6_prepare_proving_key(
+        pk_path: *const c_char,
+        window: c_int,
+        threads: c_int,
+    ) -> bool;
+
+    fn _pghr13_mnt6_context_new() -> *mut c_void;
+
+    fn _pghr13_context_free(context: *mut c_void);
+
+    fn _pghr13_context_generate_proof(
+        context: *mut c_void,
+        pk_path: *const c_char,
+        proof_path: *const c_char,
+        public_inputs: *const u8,
+        public_inputs_length: c_int,
+        private_inputs: *const u8,
+        private_inputs_length: c_int,
+        threads: c_int,
+    ) -> bool;
 }
 
 pub struct PGHR13_MNT6 {}
@@ -52,12 +102,7 @@ impl PGHR13_MNT6 {
 impl ProofSystem for PGHR13_MNT6 {
     fn setup(&self, program: ir::Prog<FieldPrime>, pk_path: &str, vk_path: &str) {
         let (
-            a_arr,
-            b_arr,
-            c_arr,
-            a_vec,
-            b_vec,
-            c_vec,
+            mut constraints,
             num_constraints,
             num_variables,
             num_inputs,
@@ -66,18 +111,15 @@ impl ProofSystem for PGHR13_MNT6 {
         ) = prepare_setup(program, pk_path, vk_path);
 
         unsafe {
-            _pghr13_mnt6_setup(
-                a_arr.as_ptr(),
-                b_arr.as_ptr(),
-                c_arr.as_ptr(),
-                a_vec.len() as i32,
-                b_vec.len() as i32,
-                c_vec.len() as i32,
+            _pghr13_mnt6_setup_streamed(
+                next_constraint_chunk::<FieldPrime>,
+                &mut constraints as *mut ConstraintStream<FieldPrime> as *mut c_void,
                 num_constraints as i32,
                 num_variables as i32,
                 num_inputs as i32,
                 pk_path_cstring.as_ptr(),
                 vk_path_cstring.as_ptr(),
+                threads() as c_int,
             );
         }
     }
@@ -89,14 +131,8 @@ impl ProofSystem for PGHR13_MNT6 {
         pk_path: &str,
         proof_path: &str,
     ) -> bool {
-        let (
-            pk_path_cstring,
-            proof_path_cstring,
-            public_inputs_arr,
-            public_inputs_length,
-            private_inputs_arr,
-            private_inputs_length,
-        ) = prepare_generate_proof(program, witness, pk_path, proof_path);
+        let (pk_path_cstring, proof_path_cstring, mut witness_limbs, public_inputs_length, variables) =
+            prepare_witness_limbs(program, witness, pk_path, proof_path);
 
         println!(
             "{:?}",
@@ -104,17 +140,47 @@ impl ProofSystem for PGHR13_MNT6 {
         );
 
         unsafe {
-            _pghr13_mnt6_generate_proof(
+            _pghr13_mnt6_generate_proof_limbs(
                 pk_path_cstring.as_ptr(),
                 proof_path_cstring.as_ptr(),
-                public_inputs_arr[0].as_ptr(),
-                public_inputs_length as i32,
-                private_inputs_arr[0].as_ptr(),
-                private_inputs_length as i32,
+                witness_limbs.as_mut_ptr(),
+                public_inputs_length as c_int,
+                variables as c_int,
+                threads() as c_int,
             )
         }
     }
 
+    fn generate_proofs(
+        &self,
+        program: ir::Prog<FieldPrime>,
+        witnesses: Vec<ir::Witness<FieldPrime>>,
+        pk_path: &str,
+        proof_paths: &[String],
+    ) -> Vec<bool> {
+        let (pk_path_cstring, proof_paths_cstring, mut witnesses_limbs, public_inputs_length, variables) =
+            prepare_witnesses_limbs(program, witnesses, pk_path, proof_paths);
+        let proof_paths_ptr: Vec<*const c_char> =
+            proof_paths_cstring.iter().map(|p| p.as_ptr()).collect();
+        let witnesses_ptr: Vec<*mut u64> =
+            witnesses_limbs.iter_mut().map(|w| w.as_mut_ptr()).collect();
+        let count = proof_paths_ptr.len().min(witnesses_ptr.len());
+        let mut results = vec![false; count];
+        unsafe {
+            _pghr13_mnt6_generate_proofs_limbs(
+                pk_path_cstring.as_ptr(),
+                proof_paths_ptr.as_ptr(),
+                witnesses_ptr.as_ptr(),
+                count as c_int,
+                public_inputs_length as c_int,
+                variables as c_int,
+                results.as_mut_ptr(),
+                threads() as c_int,
+            );
+        }
+        results
+    }
+
     fn verify_proof(
         &self,
         vk_path: &str,
@@ -130,7 +196,88 @@ impl ProofSystem for PGHR13_MNT6 {
         }
     }
 
+    fn verify_proofs(&self, vk_path: &str, proof_paths: &[String]) -> Vec<bool> {
+        let vk_path_cstring = CString::new(vk_path).unwrap();
+        let proof_paths_cstring: Vec<CString> = proof_paths
+            .iter()
+            .map(|p| CString::new(p.as_str()).unwrap())
+            .collect();
+        let proof_paths_ptr: Vec<*const c_char> =
+            proof_paths_cstring.iter().map(|p| p.as_ptr()).collect();
+        let mut results = vec![false; proof_paths.len()];
+        unsafe {
+            _pghr13_mnt6_verify_proofs(
+                vk_path_cstring.as_ptr(),
+                proof_paths_ptr.as_ptr(),
+                proof_paths_ptr.len() as c_int,
+                results.as_mut_ptr(),
+                threads() as c_int,
+            );
+        }
+        results
+    }
+
+    fn prepare_proving_key(&self, pk_path: &str, window: usize) -> bool {
+        let pk_path_cstring = CString::new(pk_path).unwrap();
+        unsafe {
+            _pghr13_mnt6_prepare_proving_key(
+                pk_path_cstring.as_ptr(),
+                window as c_int,
+                threads() as c_int,
+            )
+        }
+    }
+
     fn export_solidity_verifier(&self, _: BufReader<File>) -> String {
         panic!("Not implemented");
     }
+
+    fn prover_context(&self) -> Option<Box<dyn ProverContext>> {
+        Some(Box::new(Context {
+            handle: unsafe { _pghr13_mnt6_context_new() },
+        }))
+    }
+}
+
+struct Context {
+    handle: *mut c_void,
+}
+
+impl ProverContext for Context {
+    fn generate_proof(
+        &self,
+        program: &ir::Prog<FieldPrime>,
+        program_hash: u64,
+        witness: ir::Witness<FieldPrime>,
+        pk_path: &str,
+        proof_path: &str,
+    ) -> bool {
+        let (
+            pk_path_cstring,
+            proof_path_cstring,
+            public_inputs_arr,
+            public_inputs_length,
+            private_inputs_arr,
+            private_inputs_length,
+        ) = prepare_generate_proof(program, program_hash, witness, pk_path, proof_path);
+
+        unsafe {
+            _pghr13_context_generate_proof(
+                self.handle,
+                pk_path_cstring.as_ptr(),
+                proof_path_cstring.as_ptr(),
+                public_inputs_arr[0].as_ptr(),
+                public_inputs_length as i32,
+                private_inputs_arr[0].as_ptr(),
+                private_inputs_length as i32,
+                threads() as c_int,
+            )
+        }
+    }
+}
+
+impl Drop for Context {
+    fn drop(&mut self) {
+        unsafe { _pghr13_context_free(self.handle) }
+    }
 }
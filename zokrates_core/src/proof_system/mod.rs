@@ -2,6 +2,8 @@ mod bn128;
 mod mnt;
 #[cfg(feature = "libsnark")]
 mod batch;
+#[cfg_attr(not(feature = "libsnark"), allow(dead_code))]
+mod variable_map;
 
 use std::fs::File;
 use zokrates_field::field::FieldPrime;
@@ -17,9 +19,23 @@ pub use self::mnt::PGHR13_MNT4;
 pub use self::mnt::PGHR13_MNT6;
 #[cfg(feature = "libsnark")]
 pub use self::batch::*;
+pub use self::variable_map::program_hash;
 
 use crate::ir;
 use std::io::BufReader;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+static THREADS: AtomicUsize = AtomicUsize::new(0);
+
+/// Sets how many threads the libsnark backends may use in setup, proving and batching.
+/// `0` leaves the choice to OpenMP. Only has an effect with the `multicore` feature.
+pub fn set_threads(threads: usize) {
+    THREADS.store(threads, Ordering::Relaxed);
+}
+
+pub fn threads() -> usize {
+    THREADS.load(Ordering::Relaxed)
+}
 
 pub trait ProofSystem {
     fn setup(&self, program: ir::Prog<FieldPrime>, pk_path: &str, vk_path: &str);
@@ -32,11 +48,62 @@ pub trait ProofSystem {
         proof_path: &str,
     ) -> bool;
 
+    /// Proves each witness of one program against the same key, writing proof `i` to
+    /// `proof_paths[i]`, and returns whether each proof was written
+    fn generate_proofs(
+        &self,
+        program: ir::Prog<FieldPrime>,
+        witnesses: Vec<ir::Witness<FieldPrime>>,
+        pk_path: &str,
+        proof_paths: &[String],
+    ) -> Vec<bool> {
+        witnesses
+            .into_iter()
+            .zip(proof_paths)
+            .map(|(witness, proof_path)| {
+                self.generate_proof(program.clone(), witness, pk_path, proof_path)
+            })
+            .collect()
+    }
+
     fn verify_proof(
         &self,
         vk_path: &str,
         proof_path: &str,
     ) -> bool;
 
+    /// Verifies several proofs against one verification key, returning one result per proof
+    fn verify_proofs(&self, vk_path: &str, proof_paths: &[String]) -> Vec<bool> {
+        proof_paths
+            .iter()
+            .map(|proof_path| self.verify_proof(vk_path, proof_path))
+            .collect()
+    }
+
+    /// Writes fixed-base tables for the prover's multi-exponentiations next to the proving key,
+    /// which `generate_proof` then uses. `window` is the digit width in bits, `0` picks one per
+    /// table. Returns false if the backend has no prepared keys or preparation failed.
+    fn prepare_proving_key(&self, _pk_path: &str, _window: usize) -> bool {
+        false
+    }
+
     fn export_solidity_verifier(&self, reader: BufReader<File>) -> String;
+
+    /// Returns a long-lived prover keeping proving keys loaded between calls, if the backend supports it
+    fn prover_context(&self) -> Option<Box<dyn ProverContext>> {
+        None
+    }
+}
+
+pub trait ProverContext {
+    /// Proves `witness` of `program`, given the `program_hash` of it that callers proving
+    /// one program repeatedly keep along with it
+    fn generate_proof(
+        &self,
+        program: &ir::Prog<FieldPrime>,
+        program_hash: u64,
+        witness: ir::Witness<FieldPrime>,
+        pk_path: &str,
+        proof_path: &str,
+    ) -> bool;
 }
@@ -0,0 +1,167 @@
+//! Order of the R1CS variables of a program, as laid out by the libsnark backends.
+//!
+//! Setup writes it next to the proving key (`<pk>.vars`) together with a hash of the
+//! program, so proving can arrange the witness without rebuilding the constraint system.
+
+use bincode::{deserialize_from, serialize_into, Infinite};
+use flat_absy::FlatVariable;
+use ir;
+pub use ir::{provide_variable_idx, variable_indices, variable_list};
+use std::collections::HashMap;
+use std::fs::File;
+use std::io::{self, BufReader, BufWriter, Write};
+use zokrates_field::field::Field;
+
+const VARIABLE_MAP_VERSION: u32 = 1;
+
+#[derive(Serialize, Deserialize)]
+pub struct VariableMap {
+    version: u32,
+    program_hash: u64,
+    /// number of leading variables (`~one`, public arguments, `~out_*`) that are public
+    pub public_count: usize,
+    /// variables ordered by their index in the constraint system
+    pub variables: Vec<FlatVariable>,
+}
+
+impl VariableMap {
+    pub fn new<T: Field>(prog: &ir::Prog<T>) -> VariableMap {
+        let (variables, public_count) = variable_indices(prog);
+        VariableMap::from_indices(program_hash(prog), variables, public_count)
+    }
+
+    pub fn from_indices(
+        program_hash: u64,
+        variables: HashMap<FlatVariable, usize>,
+        public_count: usize,
+    ) -> VariableMap {
+        VariableMap::from_variables(program_hash, variable_list(variables), public_count)
+    }
+
+    pub fn from_variables(
+        program_hash: u64,
+        variables: Vec<FlatVariable>,
+        public_count: usize,
+    ) -> VariableMap {
+        VariableMap {
+            version: VARIABLE_MAP_VERSION,
+            program_hash,
+            public_count,
+            variables,
+        }
+    }
+
+    pub fn write(&self, path: &str) -> io::Result<()> {
+        let mut writer = BufWriter::new(File::create(path)?);
+        serialize_into(&mut writer, self, Infinite)
+            .map_err(|e| io::Error::new(io::ErrorKind::Other, e.to_string()))?;
+        writer.flush()
+    }
+
+    /// Reads the map at `path` if it was written for a program hashing to `program_hash`
+    pub fn read(path: &str, program_hash: u64) -> Option<VariableMap> {
+        let file = File::open(path).ok()?;
+        let map: VariableMap = deserialize_from(&mut BufReader::new(file), Infinite).ok()?;
+        if map.version == VARIABLE_MAP_VERSION && map.program_hash == program_hash {
+            Some(map)
+        } else {
+            None
+        }
+    }
+
+    /// The map written by setup for `prog`, or the one derived from `prog` when it is
+    /// missing or was written for another program
+    pub fn load_or_derive<T: Field>(pk_path: &str, prog: &ir::Prog<T>) -> VariableMap {
+        VariableMap::load_or_derive_hashed(pk_path, prog, program_hash(prog))
+    }
+
+    /// Same as `load_or_derive`, for a program whose `program_hash` is already known
+    pub fn load_or_derive_hashed<T: Field>(
+        pk_path: &str,
+        prog: &ir::Prog<T>,
+        hash: u64,
+    ) -> VariableMap {
+        VariableMap::read(&variable_map_path(pk_path), hash).unwrap_or_else(|| {
+            let (variables, public_count) = variable_indices(prog);
+            VariableMap::from_indices(hash, variables, public_count)
+        })
+    }
+}
+
+pub fn variable_map_path(pk_path: &str) -> String {
+    format!("{}.vars", pk_path)
+}
+
+// 64-bit FNV-1a, fed with the serialized program
+struct FnvHasher(u64);
+
+impl Write for FnvHasher {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        for byte in buf {
+            self.0 = (self.0 ^ *byte as u64).wrapping_mul(0x100000001b3);
+        }
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
+/// Hash of the bincode serialization of `prog`, stable across runs and builds
+pub fn program_hash<T: Field>(prog: &ir::Prog<T>) -> u64 {
+    let mut hasher = FnvHasher(0xcbf29ce484222325);
+    serialize_into(&mut hasher, prog, Infinite).unwrap();
+    hasher.0
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use ir::{Function, Prog, Statement};
+    use std::env;
+    use zokrates_field::field::FieldPrime;
+
+    fn program(private: bool) -> Prog<FieldPrime> {
+        Prog {
+            main: Function {
+                id: String::from("main"),
+                arguments: vec![FlatVariable::new(0)],
+                returns: vec![FlatVariable::public(0)],
+                statements: vec![Statement::definition(
+                    FlatVariable::public(0),
+                    FlatVariable::new(0),
+                )],
+            },
+            private: vec![private],
+        }
+    }
+
+    #[test]
+    fn round_trip_checks_program_hash() {
+        let pk_path = env::temp_dir().join(format!("zokrates_variable_map_{}", std::process::id()));
+        let pk_path = pk_path.to_str().unwrap();
+        let path = variable_map_path(pk_path);
+
+        let public = program(false);
+        let map = VariableMap::new(&public);
+        assert_eq!(map.public_count, 3);
+        assert_eq!(
+            map.variables,
+            vec![FlatVariable::one(), FlatVariable::new(0), FlatVariable::public(0)]
+        );
+        map.write(&path).unwrap();
+
+        let read = VariableMap::load_or_derive(pk_path, &public);
+        assert_eq!(read.variables, map.variables);
+        assert_eq!(read.public_count, map.public_count);
+
+        // a map written for another program is ignored
+        let private = program(true);
+        assert!(program_hash(&private) != program_hash(&public));
+        assert!(VariableMap::read(&path, program_hash(&private)).is_none());
+        assert_eq!(VariableMap::load_or_derive(pk_path, &private).public_count, 2);
+
+        std::fs::remove_file(&path).unwrap();
+    }
+}